@@ -19,3 +19,9 @@
 -keep class com.orion.downloader.core.DownloadEngine {
     native <methods>;
 }
+
+-keep class com.orion.downloader.core.NativeDownloadEngine { *; }
+-keep class com.orion.downloader.core.NativeDownloadEngine$* { *; }
+-keep class com.orion.downloader.core.NativeDownloadManager { *; }
+-keep class com.orion.downloader.core.NativeDownloadManager$* { *; }
+-keep class com.orion.downloader.core.NativeProgressBoard { *; }
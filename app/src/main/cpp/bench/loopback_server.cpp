@@ -0,0 +1,293 @@
+#include "loopback_server.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace orion {
+
+constexpr size_t PATTERN_SIZE = 1024 * 1024;
+constexpr size_t SLICE_SIZE = 64 * 1024;
+constexpr int RTO_MIN_MS = 200;
+constexpr size_t MAX_HEADER_SIZE = 16 * 1024;
+
+static const std::vector<char>& pattern() {
+    static const std::vector<char> bytes = [] {
+        std::vector<char> data(PATTERN_SIZE);
+        for (size_t i = 0; i < data.size(); ++i) {
+            data[i] = static_cast<char>(LoopbackServer::patternAt(static_cast<int64_t>(i)));
+        }
+        return data;
+    }();
+    return bytes;
+}
+
+uint8_t LoopbackServer::patternAt(int64_t offset) {
+    uint32_t value = static_cast<uint32_t>(offset % PATTERN_SIZE) * 2654435761u;
+    return static_cast<uint8_t>(value >> 24);
+}
+
+struct LoopbackServer::Request {
+    std::string method;
+    std::string path;
+    std::string range;
+    bool keep_alive = true;
+};
+
+static std::string lowercase(std::string value) {
+    for (char& c : value) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    return value;
+}
+
+LoopbackServer::LoopbackServer(const LinkProfile& profile)
+    : profile_(profile)
+    , listen_fd_(-1)
+    , port_(0) {
+}
+
+LoopbackServer::~LoopbackServer() {
+    closeListener();
+}
+
+bool LoopbackServer::listen() {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) return false;
+
+    int one = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t length = sizeof(addr);
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listen_fd_, 128) != 0 ||
+        getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &length) != 0) {
+        closeListener();
+        return false;
+    }
+    port_ = ntohs(addr.sin_port);
+    return true;
+}
+
+void LoopbackServer::closeListener() {
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        listen_fd_ = -1;
+    }
+}
+
+void LoopbackServer::run() {
+    pattern();
+    for (;;) {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("accept");
+            _exit(1);
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        std::thread(&LoopbackServer::serve, this, fd).detach();
+    }
+}
+
+void LoopbackServer::serve(int fd) {
+    std::string pending;
+    char buffer[4096];
+    bool open = true;
+
+    while (open) {
+        size_t end;
+        while ((end = pending.find("\r\n\r\n")) == std::string::npos) {
+            if (pending.size() > MAX_HEADER_SIZE) {
+                open = false;
+                break;
+            }
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                open = false;
+                break;
+            }
+            pending.append(buffer, n);
+        }
+        if (!open) break;
+
+        Request request;
+        bool parsed = parseRequest(pending.substr(0, end), request);
+        pending.erase(0, end + 4);
+        if (!parsed) {
+            static const char BAD[] = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n"
+                                      "Connection: close\r\n\r\n";
+            send(fd, BAD, sizeof(BAD) - 1, MSG_NOSIGNAL);
+            break;
+        }
+        open = respond(fd, request) && request.keep_alive;
+    }
+    close(fd);
+}
+
+bool LoopbackServer::parseRequest(const std::string& head, Request& request) {
+    std::istringstream lines(head);
+    std::string line;
+    if (!std::getline(lines, line)) return false;
+
+    std::istringstream start(line);
+    std::string version;
+    start >> request.method >> request.path >> version;
+    if (request.method.empty() || request.path.empty()) return false;
+    request.keep_alive = version != "HTTP/1.0";
+
+    size_t query = request.path.find('?');
+    if (query != std::string::npos) request.path.erase(query);
+
+    while (std::getline(lines, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        std::string name = lowercase(line.substr(0, colon));
+        std::string value = line.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(' '));
+        if (name == "range") {
+            request.range = value;
+        } else if (name == "connection") {
+            request.keep_alive = lowercase(value) != "close";
+        }
+    }
+    return true;
+}
+
+// Sleeps so the connection never runs ahead of the configured bandwidth,
+// and occasionally stalls for one RTO to model a lost segment.
+bool LoopbackServer::sendPaced(int fd, const char* data, size_t length) {
+    thread_local std::minstd_rand random(std::random_device{}());
+    thread_local auto window_start = std::chrono::steady_clock::now();
+    thread_local int64_t window_bytes = 0;
+
+    while (length > 0) {
+        size_t slice = std::min(length, SLICE_SIZE);
+        if (profile_.loss > 0 &&
+            std::uniform_real_distribution<double>(0.0, 1.0)(random) < profile_.loss) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(
+                std::max(RTO_MIN_MS, profile_.latency_ms * 2)));
+        }
+        if (profile_.bandwidth_bps > 0) {
+            auto now = std::chrono::steady_clock::now();
+            if (now - window_start > std::chrono::seconds(1)) {
+                window_start = now;
+                window_bytes = 0;
+            }
+            auto due = window_start + std::chrono::microseconds(
+                window_bytes * 1000000 / profile_.bandwidth_bps);
+            std::this_thread::sleep_until(due);
+            window_bytes += slice;
+        }
+
+        ssize_t n = send(fd, data, slice, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        length -= n;
+    }
+    return true;
+}
+
+bool LoopbackServer::sendBody(int fd, int64_t first, int64_t last) {
+    const std::vector<char>& bytes = pattern();
+    while (first <= last) {
+        size_t at = static_cast<size_t>(first % PATTERN_SIZE);
+        size_t length = static_cast<size_t>(std::min<int64_t>(PATTERN_SIZE - at, last - first + 1));
+        if (!sendPaced(fd, bytes.data() + at, length)) return false;
+        first += length;
+    }
+    return true;
+}
+
+bool LoopbackServer::respond(int fd, const Request& request) {
+    if (profile_.latency_ms > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(profile_.latency_ms));
+    }
+
+    bool chunked = request.path.compare(0, 9, "/chunked/") == 0;
+    bool file = request.path.compare(0, 6, "/file/") == 0;
+    int64_t size = -1;
+    if (chunked || file) {
+        size = strtoll(request.path.c_str() + (chunked ? 9 : 6), nullptr, 10);
+    }
+
+    std::ostringstream head;
+    if (size < 0 || (request.method != "GET" && request.method != "HEAD")) {
+        head << "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+        std::string text = head.str();
+        return sendPaced(fd, text.data(), text.size());
+    }
+    bool head_only = request.method == "HEAD";
+
+    if (chunked) {
+        head << "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n"
+             << "Content-Type: application/octet-stream\r\n\r\n";
+        std::string text = head.str();
+        if (!sendPaced(fd, text.data(), text.size())) return false;
+        if (head_only) return true;
+
+        for (int64_t offset = 0; offset < size; offset += SLICE_SIZE) {
+            int64_t length = std::min<int64_t>(SLICE_SIZE, size - offset);
+            char line[32];
+            int n = snprintf(line, sizeof(line), "%llx\r\n", (long long)length);
+            if (!sendPaced(fd, line, n) || !sendBody(fd, offset, offset + length - 1) ||
+                !sendPaced(fd, "\r\n", 2)) {
+                return false;
+            }
+        }
+        return sendPaced(fd, "0\r\n\r\n", 5);
+    }
+
+    int64_t first = 0;
+    int64_t last = size - 1;
+    bool partial = false;
+    if (request.range.compare(0, 6, "bytes=") == 0) {
+        const char* spec = request.range.c_str() + 6;
+        char* dash;
+        first = strtoll(spec, &dash, 10);
+        last = *dash == '-' && dash[1] ? strtoll(dash + 1, nullptr, 10) : size - 1;
+        last = std::min(last, size - 1);
+        if (first >= size || first > last) {
+            head << "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */" << size
+                 << "\r\nContent-Length: 0\r\n\r\n";
+            std::string text = head.str();
+            return sendPaced(fd, text.data(), text.size());
+        }
+        partial = true;
+    }
+
+    head << (partial ? "HTTP/1.1 206 Partial Content\r\n" : "HTTP/1.1 200 OK\r\n")
+         << "Content-Length: " << (last - first + 1) << "\r\n"
+         << "Accept-Ranges: bytes\r\n"
+         << "ETag: \"" << size << "\"\r\n"
+         << "Content-Type: application/octet-stream\r\n";
+    if (partial) {
+        head << "Content-Range: bytes " << first << "-" << last << "/" << size << "\r\n";
+    }
+    if (!request.keep_alive) {
+        head << "Connection: close\r\n";
+    }
+    head << "\r\n";
+    std::string text = head.str();
+    if (!sendPaced(fd, text.data(), text.size())) return false;
+    return head_only || sendBody(fd, first, last);
+}
+
+}
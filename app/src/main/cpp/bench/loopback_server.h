@@ -0,0 +1,55 @@
+#ifndef ORION_LOOPBACK_SERVER_H
+#define ORION_LOOPBACK_SERVER_H
+
+#include <cstdint>
+#include <string>
+
+namespace orion {
+
+struct LinkProfile {
+    // Per-connection bytes per second; 0 sends as fast as the socket takes it.
+    int64_t bandwidth_bps = 0;
+    // Added before every response's headers, roughly one round trip.
+    int latency_ms = 0;
+    // Chance per 64 KiB slice of stalling one retransmission timeout, which
+    // is what a dropped segment costs a TCP sender.
+    double loss = 0.0;
+};
+
+// Minimal HTTP/1.1 origin on 127.0.0.1 serving synthetic bodies:
+//   /file/<bytes>     Content-Length, Range, keep-alive and pipelining
+//   /chunked/<bytes>  chunked transfer encoding, no ranges
+// A query string is ignored, so callers can defeat metadata caches.
+// listen() binds in the calling process; run() serves forever and is meant
+// for a forked child so the server's CPU is not billed to the client.
+class LoopbackServer {
+public:
+    explicit LoopbackServer(const LinkProfile& profile);
+    ~LoopbackServer();
+
+    bool listen();
+    int port() const { return port_; }
+    void closeListener();
+    [[noreturn]] void run();
+
+    // Byte at the given offset of every synthetic body.
+    static uint8_t patternAt(int64_t offset);
+
+private:
+    struct Request;
+
+    static bool parseRequest(const std::string& head, Request& request);
+
+    void serve(int fd);
+    bool respond(int fd, const Request& request);
+    bool sendPaced(int fd, const char* data, size_t length);
+    bool sendBody(int fd, int64_t first, int64_t last);
+
+    LinkProfile profile_;
+    int listen_fd_;
+    int port_;
+};
+
+}
+
+#endif
@@ -0,0 +1,343 @@
+// Loopback throughput benchmark for DownloadEngine. The origin runs in a
+// forked child, so CPU figures cover the engine alone.
+//
+//   orion_bench [--connections 1,4,8,16] [--sizes 16M,256M] [--reps 3]   (0 connections = auto)
+//               [--bandwidth 0] [--latency 0] [--loss 0] [--backend threaded|event|splice]
+//               [--write-behind 0] [--sync 0] [--endgame 2M]
+//               [--chunked] [--dir /tmp] [--no-verify] [--stats] [--verbose]
+
+#include "download_engine.h"
+#include "log.h"
+#include "loopback_server.h"
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace orion;
+
+struct BenchConfig {
+    std::vector<int> connections = {1, 4, 8, 16};
+    std::vector<int64_t> sizes = {16LL << 20, 256LL << 20};
+    int reps = 3;
+    LinkProfile link;
+    IoBackend backend = IoBackend::Threaded;
+    int write_behind = 0;
+    int64_t sync_bytes = 0;
+    int64_t endgame_bytes = DownloadOptions().endgame_bytes;
+    bool chunked = false;
+    bool verify = true;
+    bool stats = false;
+    bool verbose = false;
+    std::string dir = "/tmp";
+};
+
+struct RunResult {
+    bool ok = false;
+    double seconds = 0;
+    double cpu_seconds = 0;
+    double ttfb_ms = 0;
+    double tail_ms = 0;
+};
+
+static bool verbose_logging = false;
+
+static void benchLogSink(LogLevel level, const char* tag, const char* message) {
+    if (verbose_logging || level >= LogLevel::Warn) {
+        fprintf(stderr, "%s: %s\n", tag, message);
+    }
+}
+
+static double nowSeconds() {
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double cpuSeconds() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static int64_t parseSize(const char* text) {
+    char* suffix;
+    double value = strtod(text, &suffix);
+    switch (*suffix) {
+        case 'k': case 'K': return static_cast<int64_t>(value * (1LL << 10));
+        case 'm': case 'M': return static_cast<int64_t>(value * (1LL << 20));
+        case 'g': case 'G': return static_cast<int64_t>(value * (1LL << 30));
+        default: return static_cast<int64_t>(value);
+    }
+}
+
+template <typename T, typename Parse>
+static std::vector<T> parseList(const char* text, Parse parse) {
+    std::vector<T> values;
+    std::string list(text);
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == std::string::npos) comma = list.size();
+        if (comma > start) values.push_back(parse(list.substr(start, comma - start).c_str()));
+        start = comma + 1;
+    }
+    return values;
+}
+
+static bool parseArgs(int argc, char** argv, BenchConfig& config) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool takes_value = true;
+        if (arg == "--connections" && value) {
+            config.connections = parseList<int>(value, [](const char* v) { return atoi(v); });
+        } else if (arg == "--sizes" && value) {
+            config.sizes = parseList<int64_t>(value, parseSize);
+        } else if (arg == "--reps" && value) {
+            config.reps = std::max(atoi(value), 1);
+        } else if (arg == "--bandwidth" && value) {
+            config.link.bandwidth_bps = parseSize(value);
+        } else if (arg == "--latency" && value) {
+            config.link.latency_ms = atoi(value);
+        } else if (arg == "--loss" && value) {
+            config.link.loss = atof(value);
+        } else if (arg == "--backend" && value) {
+            config.backend = strcmp(value, "event") == 0  ? IoBackend::EventLoop
+                           : strcmp(value, "splice") == 0 ? IoBackend::Splice
+                                                          : IoBackend::Threaded;
+        } else if (arg == "--write-behind" && value) {
+            config.write_behind = std::max(atoi(value), 0);
+        } else if (arg == "--sync" && value) {
+            config.sync_bytes = parseSize(value);
+        } else if (arg == "--endgame" && value) {
+            config.endgame_bytes = parseSize(value);
+        } else if (arg == "--dir" && value) {
+            config.dir = value;
+        } else {
+            takes_value = false;
+            if (arg == "--chunked") {
+                config.chunked = true;
+            } else if (arg == "--no-verify") {
+                config.verify = false;
+            } else if (arg == "--stats") {
+                config.stats = true;
+            } else if (arg == "--verbose") {
+                config.verbose = true;
+            } else {
+                fprintf(stderr, "unknown or incomplete option %s\n", arg.c_str());
+                return false;
+            }
+        }
+        if (takes_value) ++i;
+    }
+    return !config.connections.empty() && !config.sizes.empty();
+}
+
+static int64_t histogramMedian(const std::vector<uint64_t>& buckets) {
+    uint64_t total = 0;
+    for (uint64_t count : buckets) total += count;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen * 2 >= total && total > 0) return i == 0 ? 0 : 1LL << (i - 1);
+    }
+    return 0;
+}
+
+// Sums the engine's per-connection timings into one line per run.
+static void printStats(const DownloadStats& stats) {
+    int64_t connect_us = 0, connects = 0, requests = 0, wait_us = 0;
+    int64_t stall_us = 0, throttle_us = 0, write_us = 0, first_byte_us = -1;
+    for (const ConnectionStats& connection : stats.connections) {
+        connect_us += connection.connect_us;
+        connects += connection.connects;
+        requests += connection.requests;
+        wait_us += connection.response_wait_us;
+        stall_us += connection.stall_us;
+        throttle_us += connection.throttle_us;
+        write_us += connection.write_us;
+        if (connection.first_byte_us >= 0 &&
+            (first_byte_us < 0 || connection.first_byte_us < first_byte_us)) {
+            first_byte_us = connection.first_byte_us;
+        }
+    }
+    printf("#   stats: %zu conns, %lld connects %.2fms, %lld requests avg wait %.2fms, "
+           "first byte %.2fms, stall %.1fms, throttle %.1fms, write %.1fms, "
+           "recv~%lldB, write~%lldus, hedges %lld (%lld won, %lldB wasted)\n",
+           stats.connections.size(), (long long)connects, connect_us / 1000.0,
+           (long long)requests, requests ? wait_us / 1000.0 / requests : 0.0,
+           first_byte_us / 1000.0, stall_us / 1000.0, throttle_us / 1000.0, write_us / 1000.0,
+           (long long)histogramMedian(stats.recv_size_histogram),
+           (long long)histogramMedian(stats.write_latency_histogram),
+           (long long)stats.hedges, (long long)stats.hedges_won,
+           (long long)stats.hedge_wasted_bytes);
+}
+
+static bool verifyOutput(const std::string& path, int64_t size) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    std::vector<char> buffer(1 << 20);
+    int64_t offset = 0;
+    bool ok = true;
+    while (ok && offset < size) {
+        ssize_t n = pread(fd, buffer.data(), buffer.size(), offset);
+        if (n <= 0) {
+            ok = false;
+            break;
+        }
+        for (ssize_t i = 0; i < n; ++i) {
+            if (static_cast<uint8_t>(buffer[i]) != LoopbackServer::patternAt(offset + i)) {
+                fprintf(stderr, "mismatch at offset %lld\n", (long long)(offset + i));
+                ok = false;
+                break;
+            }
+        }
+        offset += n;
+    }
+    struct stat st;
+    ok = ok && fstat(fd, &st) == 0 && st.st_size == size;
+    close(fd);
+    return ok;
+}
+
+static RunResult runOnce(const BenchConfig& config, int port, int64_t size, int connections,
+                         int run) {
+    static int sequence = 0;
+    char url[128];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/%s/%lld?run=%d", port,
+             config.chunked ? "chunked" : "file", (long long)size, sequence++);
+    std::string output = config.dir + "/orion_bench_" + std::to_string(getpid()) + ".bin";
+
+    DownloadOptions options;
+    options.num_connections = connections;
+    options.io_backend = config.backend;
+    options.collect_stats = config.stats;
+    options.write_behind_buffers = config.write_behind;
+    options.write_sync_bytes = config.sync_bytes;
+    options.endgame_bytes = config.endgame_bytes;
+
+    RunResult result;
+    DownloadEngine engine;
+    double cpu_start = cpuSeconds();
+    double start = nowSeconds();
+    double first_byte = 0;
+    double tail_start = 0;
+
+    if (!engine.startDownload(url, output, options)) {
+        fprintf(stderr, "run %d: startDownload failed\n", run);
+        return result;
+    }
+
+    // Tight polling until the first byte lands, then coarser.
+    while (engine.isDownloading()) {
+        int64_t downloaded = engine.getProgress().downloaded_bytes;
+        double now = nowSeconds();
+        if (first_byte == 0 && downloaded > 0) first_byte = now;
+        if (tail_start == 0 && downloaded >= size - size / 10) tail_start = now;
+        std::this_thread::sleep_for(std::chrono::microseconds(first_byte == 0 ? 200 : 2000));
+    }
+    double end = nowSeconds();
+
+    DownloadProgress progress = engine.getProgress();
+    result.cpu_seconds = cpuSeconds() - cpu_start;
+    result.seconds = end - start;
+    result.ttfb_ms = ((first_byte > 0 ? first_byte : end) - start) * 1000.0;
+    result.tail_ms = (end - (tail_start > 0 ? tail_start : start)) * 1000.0;
+    result.ok = progress.downloaded_bytes == size && (!config.verify || verifyOutput(output, size));
+    if (config.stats) {
+        printStats(engine.getStats());
+    }
+    unlink(output.c_str());
+    if (!result.ok) {
+        fprintf(stderr, "run %d: incomplete or corrupt (%lld of %lld bytes)\n", run,
+                (long long)progress.downloaded_bytes, (long long)size);
+    }
+    return result;
+}
+
+static double percentile(std::vector<double> values, double p) {
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    return values[std::min(index, values.size() - 1)];
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config;
+    if (!parseArgs(argc, argv, config)) {
+        return 2;
+    }
+    verbose_logging = config.verbose;
+    setLogSink(benchLogSink);
+    signal(SIGPIPE, SIG_IGN);
+
+    LoopbackServer server(config.link);
+    if (!server.listen()) {
+        perror("listen");
+        return 1;
+    }
+    pid_t child = fork();
+    if (child < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (child == 0) {
+        server.run();
+    }
+    server.closeListener();
+
+    printf("# backend=%s bandwidth=%lldB/s/conn latency=%dms loss=%.4f reps=%d "
+           "write_behind=%d sync=%lld%s\n",
+           config.backend == IoBackend::EventLoop ? "event"
+           : config.backend == IoBackend::Splice  ? "splice" : "threaded",
+           (long long)config.link.bandwidth_bps, config.link.latency_ms, config.link.loss,
+           config.reps, config.write_behind, (long long)config.sync_bytes,
+           config.chunked ? " chunked" : "");
+    printf("%10s %5s %9s %9s %9s %9s %9s %9s %5s\n", "size", "conns", "MB/s", "cpu_s/GB",
+           "ttfb_ms", "p50_ms", "p95_ms", "tail_ms", "fail");
+
+    int exit_code = 0;
+    for (int64_t size : config.sizes) {
+        for (int connections : config.connections) {
+            std::vector<double> rates, cpu, ttfb, total, tail;
+            int failures = 0;
+            for (int run = 0; run < config.reps; ++run) {
+                RunResult result = runOnce(config, server.port(), size, connections, run);
+                if (!result.ok) {
+                    failures++;
+                    continue;
+                }
+                rates.push_back(size / result.seconds / 1e6);
+                cpu.push_back(result.cpu_seconds / (size / 1e9));
+                ttfb.push_back(result.ttfb_ms);
+                total.push_back(result.seconds * 1000.0);
+                tail.push_back(result.tail_ms);
+            }
+            if (failures > 0) exit_code = 1;
+            if (rates.empty()) {
+                printf("%10lld %5d %9s %9s %9s %9s %9s %9s %5d\n", (long long)size, connections,
+                       "-", "-", "-", "-", "-", "-", failures);
+                continue;
+            }
+            printf("%10lld %5d %9.1f %9.3f %9.2f %9.1f %9.1f %9.1f %5d\n", (long long)size,
+                   connections, percentile(rates, 0.5), percentile(cpu, 0.5),
+                   percentile(ttfb, 0.5), percentile(total, 0.5), percentile(total, 0.95),
+                   percentile(tail, 0.5), failures);
+            fflush(stdout);
+        }
+    }
+
+    kill(child, SIGTERM);
+    waitpid(child, nullptr, 0);
+    return exit_code;
+}
@@ -0,0 +1,177 @@
+#include "connection_pool.h"
+#include "dns_resolver.h"
+#include "log.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+#include <chrono>
+
+#define LOG_TAG "OrionPool"
+#define LOGD(...) orion::logPrint(orion::LogLevel::Debug, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) orion::logPrint(orion::LogLevel::Error, LOG_TAG, __VA_ARGS__)
+
+namespace orion {
+
+constexpr int CONNECT_TIMEOUT = 10;
+constexpr int64_t IDLE_TIMEOUT_MS = 30000;
+constexpr size_t MAX_IDLE_PER_HOST = 8;
+
+static int64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ConnectionPool& ConnectionPool::shared() {
+    static ConnectionPool instance;
+    return instance;
+}
+
+std::string ConnectionPool::key(const std::string& host, int port) {
+    return host + ":" + std::to_string(port);
+}
+
+static int64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int ConnectionPool::connect(const std::string& host, int port, ConnectTiming* timing) {
+    int64_t started_us = timing ? nowUs() : 0;
+    std::vector<ResolvedAddress> addresses;
+    if (!DnsResolver::shared().resolve(host, port, addresses)) {
+        return -1;
+    }
+
+    int64_t resolved_us = timing ? nowUs() : 0;
+    int sockfd = connectAny(addresses, CONNECT_TIMEOUT * 1000);
+    if (timing) {
+        timing->resolve_us = resolved_us - started_us;
+        timing->connect_us = nowUs() - resolved_us;
+    }
+    if (sockfd < 0) {
+        LOGE("Failed to connect to %s:%d", host.c_str(), port);
+        // The cached addresses may be stale; resolve again next time.
+        DnsResolver::shared().invalidate(host);
+        return -1;
+    }
+
+    struct timeval timeout;
+    timeout.tv_sec = CONNECT_TIMEOUT;
+    timeout.tv_usec = 0;
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(sockfd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    int flag = 1;
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+    LOGD("Connected to %s:%d", host.c_str(), port);
+    return sockfd;
+}
+
+bool ConnectionPool::isAlive(int fd) {
+    char probe;
+    ssize_t n = recv(fd, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+    // Anything readable on an idle socket is either EOF or stray bytes;
+    // neither can carry a fresh response.
+    return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+void ConnectionPool::evictLocked(int64_t now_ms, std::vector<int>& to_close) {
+    for (auto it = idle_.begin(); it != idle_.end();) {
+        auto& sockets = it->second;
+        for (size_t i = 0; i < sockets.size();) {
+            if (now_ms - sockets[i].idle_since_ms > IDLE_TIMEOUT_MS) {
+                to_close.push_back(sockets[i].fd);
+                sockets.erase(sockets.begin() + i);
+            } else {
+                ++i;
+            }
+        }
+        it = sockets.empty() ? idle_.erase(it) : std::next(it);
+    }
+}
+
+int ConnectionPool::acquireIdle(const std::string& host, int port) {
+    std::vector<int> to_close;
+    int fd = -1;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        evictLocked(nowMs(), to_close);
+        auto it = idle_.find(key(host, port));
+        while (it != idle_.end() && !it->second.empty()) {
+            int candidate = it->second.back().fd;
+            it->second.pop_back();
+            if (isAlive(candidate)) {
+                fd = candidate;
+                break;
+            }
+            to_close.push_back(candidate);
+        }
+    }
+    for (int stale : to_close) {
+        close(stale);
+    }
+    return fd;
+}
+
+int ConnectionPool::acquire(const std::string& host, int port, bool& reused,
+                            ConnectTiming* timing) {
+    int fd = acquireIdle(host, port);
+    reused = fd >= 0;
+    if (reused) {
+        return fd;
+    }
+    return connect(host, port, timing);
+}
+
+void ConnectionPool::release(const std::string& host, int port, int fd, bool reusable) {
+    if (fd < 0) return;
+
+    if (reusable) {
+        int flags = fcntl(fd, F_GETFL);
+        if (flags >= 0 && (flags & O_NONBLOCK)) {
+            fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& sockets = idle_[key(host, port)];
+        if (sockets.size() < MAX_IDLE_PER_HOST) {
+            sockets.push_back({fd, nowMs()});
+            return;
+        }
+    }
+    close(fd);
+}
+
+void ConnectionPool::evictIdle() {
+    std::vector<int> to_close;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        evictLocked(nowMs(), to_close);
+    }
+    for (int fd : to_close) {
+        close(fd);
+    }
+}
+
+void ConnectionPool::clear() {
+    std::vector<int> to_close;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& entry : idle_) {
+            for (auto& socket : entry.second) {
+                to_close.push_back(socket.fd);
+            }
+        }
+        idle_.clear();
+    }
+    for (int fd : to_close) {
+        close(fd);
+    }
+}
+
+}
@@ -0,0 +1,50 @@
+#ifndef ORION_CONNECTION_POOL_H
+#define ORION_CONNECTION_POOL_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace orion {
+
+struct ConnectTiming {
+    int64_t resolve_us = 0;
+    int64_t connect_us = 0;
+};
+
+// Process-wide cache of idle persistent HTTP/1.1 sockets keyed by host:port.
+// Sockets handed out are blocking with send/receive timeouts set; callers
+// return them with release() only when the last response was fully read.
+class ConnectionPool {
+public:
+    static ConnectionPool& shared();
+
+    // timing, when given, receives how long a fresh connection took to set up.
+    int acquire(const std::string& host, int port, bool& reused,
+                ConnectTiming* timing = nullptr);
+    int acquireIdle(const std::string& host, int port);
+    void release(const std::string& host, int port, int fd, bool reusable);
+    void evictIdle();
+    void clear();
+
+    static int connect(const std::string& host, int port, ConnectTiming* timing = nullptr);
+
+private:
+    struct IdleSocket {
+        int fd;
+        int64_t idle_since_ms;
+    };
+
+    static std::string key(const std::string& host, int port);
+    static bool isAlive(int fd);
+    void evictLocked(int64_t now_ms, std::vector<int>& to_close);
+
+    std::mutex mutex_;
+    std::map<std::string, std::vector<IdleSocket>> idle_;
+};
+
+}
+
+#endif
@@ -0,0 +1,107 @@
+#include "connection_stats.h"
+#include <chrono>
+
+namespace orion {
+
+Histogram::Histogram() {
+    for (auto& count : counts) count.store(0, std::memory_order_relaxed);
+}
+
+void Histogram::record(uint64_t value) {
+    int bucket = value == 0 ? 0 : 64 - __builtin_clzll(value);
+    if (bucket >= BUCKETS) bucket = BUCKETS - 1;
+    counts[bucket].store(counts[bucket].load(std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+}
+
+void Histogram::addTo(std::vector<uint64_t>& totals) const {
+    totals.resize(BUCKETS, 0);
+    for (int i = 0; i < BUCKETS; ++i) {
+        totals[i] += counts[i].load(std::memory_order_relaxed);
+    }
+}
+
+ConnectionTimings::ConnectionTimings(int id)
+    : connection_id(id) {
+}
+
+void ConnectionTimings::recordResponse(int64_t wait_us) {
+    if (first_byte_us.load(std::memory_order_relaxed) < 0) {
+        first_byte_us.store(wait_us, std::memory_order_relaxed);
+    }
+    add(requests, 1);
+    add(response_wait_us, wait_us);
+}
+
+void ConnectionTimings::recordRecv(int64_t size, int64_t wait_us) {
+    recv_sizes.record(size > 0 ? static_cast<uint64_t>(size) : 0);
+    add(recv_wait_us, wait_us);
+    if (wait_us >= StatsRecorder::STALL_THRESHOLD_US) {
+        add(stall_us, wait_us);
+    }
+}
+
+void ConnectionTimings::recordWrite(int64_t size, int64_t elapsed_us) {
+    write_latency_us.record(static_cast<uint64_t>(elapsed_us));
+    add(write_us, elapsed_us);
+    add(bytes, size);
+}
+
+int64_t StatsRecorder::nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+StatsRecorder::StatsRecorder()
+    : enabled_(false)
+    , resolve_us_(0) {
+}
+
+void StatsRecorder::reset(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    connections_.clear();
+    resolve_us_.store(0);
+    enabled_.store(enabled);
+}
+
+ConnectionTimings* StatsRecorder::open(int connection_id) {
+    if (!enabled()) return nullptr;
+    std::lock_guard<std::mutex> lock(mutex_);
+    connections_.emplace_back(new ConnectionTimings(connection_id));
+    return connections_.back().get();
+}
+
+void StatsRecorder::recordResolve(int64_t elapsed_us) {
+    resolve_us_.fetch_add(elapsed_us, std::memory_order_relaxed);
+}
+
+DownloadStats StatsRecorder::snapshot() const {
+    DownloadStats stats;
+    stats.enabled = enabled();
+    stats.resolve_us = resolve_us_.load(std::memory_order_relaxed);
+    stats.recv_size_histogram.assign(Histogram::BUCKETS, 0);
+    stats.write_latency_histogram.assign(Histogram::BUCKETS, 0);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& timings : connections_) {
+        ConnectionStats entry;
+        entry.connection_id = timings->connection_id;
+        entry.resolve_us = timings->resolve_us.load(std::memory_order_relaxed);
+        entry.connect_us = timings->connect_us.load(std::memory_order_relaxed);
+        entry.connects = timings->connects.load(std::memory_order_relaxed);
+        entry.first_byte_us = timings->first_byte_us.load(std::memory_order_relaxed);
+        entry.requests = timings->requests.load(std::memory_order_relaxed);
+        entry.response_wait_us = timings->response_wait_us.load(std::memory_order_relaxed);
+        entry.bytes = timings->bytes.load(std::memory_order_relaxed);
+        entry.recv_wait_us = timings->recv_wait_us.load(std::memory_order_relaxed);
+        entry.stall_us = timings->stall_us.load(std::memory_order_relaxed);
+        entry.throttle_us = timings->throttle_us.load(std::memory_order_relaxed);
+        entry.write_us = timings->write_us.load(std::memory_order_relaxed);
+        stats.connections.push_back(entry);
+        timings->recv_sizes.addTo(stats.recv_size_histogram);
+        timings->write_latency_us.addTo(stats.write_latency_histogram);
+    }
+    return stats;
+}
+
+}
@@ -0,0 +1,109 @@
+#ifndef ORION_CONNECTION_STATS_H
+#define ORION_CONNECTION_STATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace orion {
+
+// Log2 buckets: bucket 0 counts zeros, bucket i counts [2^(i-1), 2^i).
+struct Histogram {
+    static constexpr int BUCKETS = 32;
+
+    Histogram();
+    void record(uint64_t value);
+    void addTo(std::vector<uint64_t>& totals) const;
+
+    std::atomic<uint64_t> counts[BUCKETS];
+};
+
+// One per connection, written only by that connection's thread or loop;
+// getStats() reads it with relaxed loads, so recording never takes a lock.
+struct ConnectionTimings {
+    explicit ConnectionTimings(int id);
+
+    int connection_id;
+    std::atomic<int64_t> resolve_us{0};
+    std::atomic<int64_t> connect_us{0};
+    std::atomic<int64_t> connects{0};
+    std::atomic<int64_t> first_byte_us{-1};
+    std::atomic<int64_t> requests{0};
+    std::atomic<int64_t> response_wait_us{0};
+    std::atomic<int64_t> bytes{0};
+    std::atomic<int64_t> recv_wait_us{0};
+    std::atomic<int64_t> stall_us{0};
+    std::atomic<int64_t> throttle_us{0};
+    std::atomic<int64_t> write_us{0};
+    Histogram recv_sizes;
+    Histogram write_latency_us;
+
+    void add(std::atomic<int64_t>& field, int64_t value) {
+        field.store(field.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+    void recordResponse(int64_t wait_us);
+    void recordRecv(int64_t size, int64_t wait_us);
+    void recordWrite(int64_t size, int64_t elapsed_us);
+};
+
+struct ConnectionStats {
+    int connection_id;
+    int64_t resolve_us;
+    int64_t connect_us;
+    int64_t connects;
+    // Request sent to response headers, for the first response; -1 if none yet.
+    int64_t first_byte_us;
+    int64_t requests;
+    int64_t response_wait_us;
+    int64_t bytes;
+    int64_t recv_wait_us;
+    // Part of the receive time spent in gaps of STALL_THRESHOLD_US or more.
+    int64_t stall_us;
+    int64_t throttle_us;
+    int64_t write_us;
+};
+
+struct DownloadStats {
+    bool enabled = false;
+    int64_t resolve_us = 0;
+    std::vector<ConnectionStats> connections;
+    // Bytes per recv and microseconds per pwrite, in Histogram buckets.
+    std::vector<uint64_t> recv_size_histogram;
+    std::vector<uint64_t> write_latency_histogram;
+    // Endgame duplicates requested, how many finished ahead of the original,
+    // and bytes either copy received that the other had already written.
+    // Kept whether or not collection is enabled.
+    int64_t hedges = 0;
+    int64_t hedges_won = 0;
+    int64_t hedge_wasted_bytes = 0;
+};
+
+class StatsRecorder {
+public:
+    static constexpr int64_t STALL_THRESHOLD_US = 100 * 1000;
+
+    static int64_t nowUs();
+
+    StatsRecorder();
+
+    void reset(bool enabled);
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    // Returns nullptr while disabled, so call sites pay one pointer test.
+    ConnectionTimings* open(int connection_id);
+    void recordResolve(int64_t elapsed_us);
+
+    DownloadStats snapshot() const;
+
+private:
+    std::atomic<bool> enabled_;
+    std::atomic<int64_t> resolve_us_;
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<ConnectionTimings>> connections_;
+};
+
+}
+
+#endif
@@ -0,0 +1,130 @@
+#include "connection_tuner.h"
+#include "log.h"
+#include <algorithm>
+
+#define LOG_TAG "OrionTuner"
+#define LOGD(...) orion::logPrint(orion::LogLevel::Debug, LOG_TAG, __VA_ARGS__)
+
+namespace orion {
+
+// New connections spend their first round trips in slow start, so a level
+// needs a couple of seconds before its rate means anything.
+constexpr int64_t WINDOW_MS = 2000;
+constexpr double GAIN_THRESHOLD = 0.10;
+constexpr int REPROBE_WINDOWS = 15;
+constexpr size_t MAX_REMEMBERED_HOSTS = 256;
+
+ConnectionTuner::Memory& ConnectionTuner::memory() {
+    static Memory instance;
+    return instance;
+}
+
+ConnectionTuner::ConnectionTuner()
+    : target_(START_CONNECTIONS)
+    , errors_(0)
+    , best_count_(START_CONNECTIONS)
+    , best_rate_(0.0)
+    , growing_(true)
+    , measured_(false)
+    , settled_windows_(0)
+    , window_start_ms_(0)
+    , window_start_bytes_(0) {
+}
+
+void ConnectionTuner::reset(const std::string& host) {
+    host_ = host;
+    int start = START_CONNECTIONS;
+    {
+        Memory& remembered = memory();
+        std::lock_guard<std::mutex> lock(remembered.mutex);
+        auto it = remembered.best.find(host);
+        if (it != remembered.best.end()) start = it->second;
+    }
+    target_.store(start);
+    errors_.store(0);
+    best_count_ = start;
+    best_rate_ = 0.0;
+    growing_ = true;
+    measured_ = false;
+    settled_windows_ = 0;
+    window_start_ms_ = 0;
+    window_start_bytes_ = 0;
+}
+
+void ConnectionTuner::setLevel(int count, int64_t now_ms, int64_t bytes) {
+    count = std::min(std::max(count, MIN_CONNECTIONS), MAX_CONNECTIONS);
+    if (count != target()) {
+        LOGD("%s: %d -> %d connections", host_.c_str(), target(), count);
+    }
+    target_.store(count);
+    window_start_ms_ = now_ms;
+    window_start_bytes_ = bytes;
+}
+
+int ConnectionTuner::sample(int64_t now_ms, int64_t bytes, bool steady) {
+    int count = target();
+    if (errors_.exchange(0) > 0) {
+        // The server is pushing back: step down and stop exploring upward.
+        growing_ = false;
+        settled_windows_ = 0;
+        best_count_ = std::min(best_count_, std::max(count - std::max(count / 4, 1),
+                                                     MIN_CONNECTIONS));
+        setLevel(best_count_, now_ms, bytes);
+        return target();
+    }
+    if (!steady || window_start_ms_ == 0) {
+        window_start_ms_ = now_ms;
+        window_start_bytes_ = bytes;
+        return count;
+    }
+    if (now_ms - window_start_ms_ < WINDOW_MS) {
+        return count;
+    }
+
+    double rate = (bytes - window_start_bytes_) * 1000.0 / (now_ms - window_start_ms_);
+    measured_ = true;
+
+    if (growing_) {
+        if (rate > best_rate_ * (1.0 + GAIN_THRESHOLD)) {
+            best_rate_ = rate;
+            best_count_ = count;
+            if (count < MAX_CONNECTIONS) {
+                setLevel(count + std::max(count / 2, 1), now_ms, bytes);
+                return target();
+            }
+        }
+        growing_ = false;
+        settled_windows_ = 0;
+        setLevel(best_count_, now_ms, bytes);
+        return target();
+    }
+
+    if (count == best_count_) {
+        // Track the settled level so a later probe compares against today's link.
+        best_rate_ = rate;
+    }
+    if (++settled_windows_ >= REPROBE_WINDOWS && best_count_ < MAX_CONNECTIONS) {
+        growing_ = true;
+        settled_windows_ = 0;
+        setLevel(best_count_ + std::max(best_count_ / 2, 1), now_ms, bytes);
+        return target();
+    }
+    setLevel(count, now_ms, bytes);
+    return count;
+}
+
+void ConnectionTuner::onConnectionError() {
+    errors_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ConnectionTuner::finish() {
+    if (!measured_ || host_.empty()) return;
+    Memory& remembered = memory();
+    std::lock_guard<std::mutex> lock(remembered.mutex);
+    if (remembered.best.size() >= MAX_REMEMBERED_HOSTS && !remembered.best.count(host_)) {
+        remembered.best.clear();
+    }
+    remembered.best[host_] = best_count_;
+}
+
+}
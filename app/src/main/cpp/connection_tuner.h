@@ -0,0 +1,60 @@
+#ifndef ORION_CONNECTION_TUNER_H
+#define ORION_CONNECTION_TUNER_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace orion {
+
+// Hill-climbs the connection count of one download. Each level is held for
+// a measurement window; the count grows while a window beats the best rate
+// so far by GAIN_THRESHOLD, settles on the best level once gains flatten,
+// and drops a step whenever connections are refused or reset. Settled
+// downloads probe one step up now and then, since links change. The best
+// count per host outlives the download and seeds the next one.
+class ConnectionTuner {
+public:
+    static constexpr int MIN_CONNECTIONS = 1;
+    static constexpr int MAX_CONNECTIONS = 32;
+    static constexpr int START_CONNECTIONS = 4;
+
+    ConnectionTuner();
+
+    void reset(const std::string& host);
+    int target() const { return target_.load(std::memory_order_relaxed); }
+
+    // Feeds the download's byte count; steady is false while paused or
+    // rate limited, when throughput says nothing about the link. Returns
+    // the new target.
+    int sample(int64_t now_ms, int64_t bytes, bool steady);
+    void onConnectionError();
+    // Remembers the best level for the host once one was measured.
+    void finish();
+
+private:
+    struct Memory {
+        std::mutex mutex;
+        std::unordered_map<std::string, int> best;
+    };
+    static Memory& memory();
+
+    void setLevel(int count, int64_t now_ms, int64_t bytes);
+
+    std::string host_;
+    std::atomic<int> target_;
+    std::atomic<int> errors_;
+    int best_count_;
+    double best_rate_;
+    bool growing_;
+    bool measured_;
+    int settled_windows_;
+    int64_t window_start_ms_;
+    int64_t window_start_bytes_;
+};
+
+}
+
+#endif
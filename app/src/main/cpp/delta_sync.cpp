@@ -0,0 +1,305 @@
+#include "delta_sync.h"
+#include "sha256.h"
+#include "log.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#define LOG_TAG "OrionDelta"
+#define LOGD(...) orion::logPrint(orion::LogLevel::Debug, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) orion::logPrint(orion::LogLevel::Error, LOG_TAG, __VA_ARGS__)
+
+namespace orion {
+
+constexpr int64_t MIN_BLOCK_SIZE = 512;
+constexpr int64_t MAX_BLOCK_SIZE = 16 * 1024 * 1024;
+// A reused run shorter than this between two fetched ranges is fetched
+// with them; a few KiB more on the wire is cheaper than another request.
+constexpr int64_t MERGE_GAP = 16 * 1024;
+
+DeltaSync::DeltaSync()
+    : block_size_(0)
+    , length_(-1)
+    , block_count_(0)
+    , rsum_bytes_(4)
+    , strong_bytes_(16)
+    , rsum_mask_(0xffffffffu)
+    , bucket_bits_(8)
+    , seed_(nullptr)
+    , seed_size_(0)
+    , reused_bytes_(0) {
+}
+
+DeltaSync::~DeltaSync() {
+    release();
+}
+
+void DeltaSync::release() {
+    if (seed_) {
+        munmap(const_cast<uint8_t*>(seed_), seed_size_);
+        seed_ = nullptr;
+        seed_size_ = 0;
+    }
+}
+
+static std::string trim(const std::string& value) {
+    size_t first = value.find_first_not_of(" \t\r");
+    if (first == std::string::npos) return std::string();
+    size_t last = value.find_last_not_of(" \t\r");
+    return value.substr(first, last - first + 1);
+}
+
+bool DeltaSync::parseManifest(const char* data, size_t size) {
+    block_size_ = 0;
+    length_ = -1;
+    block_count_ = 0;
+    file_digest_.clear();
+    index_.clear();
+    strong_.clear();
+
+    bool sha256_blocks = false;
+    size_t pos = 0;
+    while (true) {
+        size_t end = static_cast<size_t>(
+            std::find(data + pos, data + size, '\n') - data);
+        if (end == size) {
+            LOGE("Manifest header is not terminated");
+            return false;
+        }
+        std::string line = trim(std::string(data + pos, end - pos));
+        pos = end + 1;
+        if (line.empty()) break;
+
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        std::string key = line.substr(0, colon);
+        std::string value = trim(line.substr(colon + 1));
+        if (key == "Blocksize") {
+            block_size_ = strtoll(value.c_str(), nullptr, 10);
+        } else if (key == "Length") {
+            length_ = strtoll(value.c_str(), nullptr, 10);
+        } else if (key == "Hash-Lengths") {
+            int seq_matches = 0;
+            if (sscanf(value.c_str(), "%d,%d,%d", &seq_matches, &rsum_bytes_,
+                       &strong_bytes_) != 3) {
+                return false;
+            }
+        } else if (key == "Strong-Hash") {
+            sha256_blocks = value == "SHA-256";
+        } else if (key == "SHA-256") {
+            file_digest_ = value;
+            std::transform(file_digest_.begin(), file_digest_.end(), file_digest_.begin(),
+                           ::tolower);
+        }
+    }
+
+    if (!sha256_blocks) {
+        LOGE("Manifest does not use SHA-256 block hashes");
+        return false;
+    }
+    if (block_size_ < MIN_BLOCK_SIZE || block_size_ > MAX_BLOCK_SIZE || length_ < 0 ||
+        rsum_bytes_ < 1 || rsum_bytes_ > 4 ||
+        strong_bytes_ < 4 || strong_bytes_ > static_cast<int>(Sha256::DIGEST_SIZE)) {
+        LOGE("Manifest header is invalid");
+        return false;
+    }
+
+    block_count_ = (length_ + block_size_ - 1) / block_size_;
+    size_t entry_size = static_cast<size_t>(rsum_bytes_ + strong_bytes_);
+    if ((size - pos) / entry_size < static_cast<size_t>(block_count_)) {
+        LOGE("Manifest lists fewer than %lld blocks", (long long)block_count_);
+        return false;
+    }
+
+    rsum_mask_ = rsum_bytes_ == 4 ? 0xffffffffu : (1u << (8 * rsum_bytes_)) - 1;
+    index_.reserve(block_count_);
+    strong_.resize(static_cast<size_t>(block_count_) * strong_bytes_);
+    const uint8_t* entry = reinterpret_cast<const uint8_t*>(data + pos);
+    for (int64_t block = 0; block < block_count_; ++block) {
+        uint32_t rsum = 0;
+        for (int i = 0; i < rsum_bytes_; ++i) {
+            rsum = (rsum << 8) | entry[i];
+        }
+        index_.emplace_back(rsum, block);
+        memcpy(&strong_[block * strong_bytes_], entry + rsum_bytes_, strong_bytes_);
+        entry += entry_size;
+    }
+
+    // Open hashing into about one bucket per block, so a window whose
+    // checksum is unknown costs a single probe.
+    bucket_bits_ = 8;
+    while (bucket_bits_ < 30 && (int64_t(1) << bucket_bits_) < block_count_) ++bucket_bits_;
+    std::sort(index_.begin(), index_.end(),
+              [this](const std::pair<uint32_t, int64_t>& left,
+                     const std::pair<uint32_t, int64_t>& right) {
+                  return std::make_pair(bucketOf(left.first), left.first) <
+                         std::make_pair(bucketOf(right.first), right.first);
+              });
+    buckets_.assign((size_t(1) << bucket_bits_) + 1, 0);
+    for (const auto& entry : index_) {
+        ++buckets_[bucketOf(entry.first) + 1];
+    }
+    for (size_t bucket = 1; bucket < buckets_.size(); ++bucket) {
+        buckets_[bucket] += buckets_[bucket - 1];
+    }
+    return true;
+}
+
+uint32_t DeltaSync::bucketOf(uint32_t rsum) const {
+    return (rsum * 2654435761u) >> (32 - bucket_bits_);
+}
+
+// rsync's checksum: a is the byte sum, b the sum of the running a values,
+// both mod 2^16.
+uint32_t DeltaSync::rsumOf(const uint8_t* data) const {
+    uint32_t a = 0;
+    uint32_t b = 0;
+    for (int64_t i = 0; i < block_size_; ++i) {
+        a += data[i];
+        b += a;
+    }
+    return ((a & 0xffff) << 16) | (b & 0xffff);
+}
+
+bool DeltaSync::strongMatches(const uint8_t* data, int64_t block, uint8_t* digest,
+                              bool& hashed) const {
+    if (!hashed) {
+        Sha256 hasher;
+        hasher.update(data, static_cast<size_t>(block_size_));
+        hasher.finish(digest);
+        hashed = true;
+    }
+    return memcmp(digest, &strong_[block * strong_bytes_], strong_bytes_) == 0;
+}
+
+bool DeltaSync::matchSeed(const std::string& path) {
+    release();
+    copies_.clear();
+    missing_.clear();
+    reused_bytes_ = 0;
+    if (block_count_ == 0) return false;
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        LOGE("Cannot map local copy %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    seed_ = static_cast<const uint8_t*>(mapped);
+    seed_size_ = static_cast<size_t>(st.st_size);
+    madvise(mapped, seed_size_, MADV_SEQUENTIAL);
+
+    std::vector<int64_t> sources(block_count_, -1);
+    int64_t found = 0;
+    int64_t size = static_cast<int64_t>(seed_size_);
+    uint8_t digest[Sha256::DIGEST_SIZE];
+
+    // Roll one byte at a time until a window matches, then jump a block.
+    if (size >= block_size_) {
+        int64_t pos = 0;
+        uint32_t rsum = rsumOf(seed_);
+        uint32_t a = rsum >> 16;
+        uint32_t b = rsum & 0xffff;
+        while (found < block_count_) {
+            uint32_t key = (((a & 0xffff) << 16) | (b & 0xffff)) & rsum_mask_;
+            uint32_t bucket = bucketOf(key);
+            bool matched = false;
+            bool hashed = false;
+            for (uint32_t i = buckets_[bucket]; i < buckets_[bucket + 1]; ++i) {
+                if (index_[i].first != key) continue;
+                int64_t block = index_[i].second;
+                if (!strongMatches(seed_ + pos, block, digest, hashed)) continue;
+                matched = true;
+                if (sources[block] < 0) {
+                    sources[block] = pos;
+                    ++found;
+                }
+            }
+
+            if (matched) {
+                pos += block_size_;
+                if (pos + block_size_ > size) break;
+                rsum = rsumOf(seed_ + pos);
+                a = rsum >> 16;
+                b = rsum & 0xffff;
+                continue;
+            }
+            if (pos + block_size_ >= size) break;
+            uint32_t out = seed_[pos];
+            a += seed_[pos + block_size_] - out;
+            b += a - static_cast<uint32_t>(block_size_) * out;
+            ++pos;
+        }
+    }
+
+    // The short last block only matches a window ending in zeros, so also
+    // try it against the end of the local copy.
+    int64_t last = block_count_ - 1;
+    int64_t tail = length_ - last * block_size_;
+    if (sources[last] < 0 && tail < block_size_ && tail <= size) {
+        std::vector<uint8_t> padded(static_cast<size_t>(block_size_), 0);
+        memcpy(padded.data(), seed_ + size - tail, static_cast<size_t>(tail));
+        bool hashed = false;
+        if (strongMatches(padded.data(), last, digest, hashed)) {
+            sources[last] = size - tail;
+        }
+    }
+
+    plan(sources);
+    LOGD("Local copy supplies %lld of %lld bytes", (long long)reused_bytes_, (long long)length_);
+    return true;
+}
+
+void DeltaSync::plan(const std::vector<int64_t>& sources) {
+    std::vector<bool> fetch(block_count_);
+    for (int64_t block = 0; block < block_count_; ++block) {
+        fetch[block] = sources[block] < 0;
+    }
+    for (int64_t block = 0; block < block_count_;) {
+        if (fetch[block]) {
+            ++block;
+            continue;
+        }
+        int64_t run_end = block;
+        while (run_end < block_count_ && !fetch[run_end]) ++run_end;
+        if (block > 0 && run_end < block_count_ && (run_end - block) * block_size_ < MERGE_GAP) {
+            std::fill(fetch.begin() + block, fetch.begin() + run_end, true);
+        }
+        block = run_end;
+    }
+
+    for (int64_t block = 0; block < block_count_; ++block) {
+        int64_t start = block * block_size_;
+        int64_t length = std::min(block_size_, length_ - start);
+        if (fetch[block]) {
+            if (!missing_.empty() && missing_.back().second + 1 == start) {
+                missing_.back().second += length;
+            } else {
+                missing_.emplace_back(start, start + length - 1);
+            }
+            continue;
+        }
+        reused_bytes_ += length;
+        if (!copies_.empty() && copies_.back().target + copies_.back().length == start &&
+            copies_.back().source + copies_.back().length == sources[block]) {
+            copies_.back().length += length;
+        } else {
+            copies_.push_back({start, sources[block], length});
+        }
+    }
+}
+
+}
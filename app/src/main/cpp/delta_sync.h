@@ -0,0 +1,84 @@
+#ifndef ORION_DELTA_SYNC_H
+#define ORION_DELTA_SYNC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace orion {
+
+struct DeltaCopy {
+    int64_t target;
+    int64_t source;
+    int64_t length;
+};
+
+// Rebuilds a changed file from an older local copy plus the blocks that
+// differ, zsync style. The manifest has zsync's layout: "Key: value" header
+// lines, a blank line, then per block the trailing rsum bytes of its rolling
+// checksum (big-endian, a then b) followed by the leading strong bytes.
+//
+//   Blocksize: 4096
+//   Length: 10485760
+//   Hash-Lengths: 1,4,16
+//   Strong-Hash: SHA-256
+//   SHA-256: <hex digest of the whole file, optional>
+//
+// zsync's MD4 is replaced by truncated SHA-256, which the engine already
+// carries; manifests without that Strong-Hash line are refused. The last
+// block is hashed zero-padded to the block size, as zsync does.
+class DeltaSync {
+public:
+    static constexpr size_t MAX_MANIFEST_SIZE = 64 * 1024 * 1024;
+
+    DeltaSync();
+    ~DeltaSync();
+
+    bool parseManifest(const char* data, size_t size);
+    int64_t length() const { return length_; }
+    // Hex whole-file digest from the manifest, empty if it has none.
+    const std::string& fileDigest() const { return file_digest_; }
+
+    // Maps the local copy and looks for every manifest block in it at any
+    // offset. The mapping stays valid after the file is renamed or removed.
+    bool matchSeed(const std::string& path);
+    const uint8_t* seed() const { return seed_; }
+    const std::vector<DeltaCopy>& copies() const { return copies_; }
+    // Inclusive ranges of the new file that must be downloaded.
+    const std::vector<std::pair<int64_t, int64_t>>& missing() const { return missing_; }
+    int64_t reusedBytes() const { return reused_bytes_; }
+
+    void release();
+
+private:
+    uint32_t bucketOf(uint32_t rsum) const;
+    uint32_t rsumOf(const uint8_t* data) const;
+    bool strongMatches(const uint8_t* data, int64_t block, uint8_t* digest,
+                       bool& hashed) const;
+    void plan(const std::vector<int64_t>& sources);
+
+    int64_t block_size_;
+    int64_t length_;
+    int64_t block_count_;
+    int rsum_bytes_;
+    int strong_bytes_;
+    uint32_t rsum_mask_;
+    std::string file_digest_;
+    int bucket_bits_;
+    // (masked rsum, block) grouped by bucket; buckets_ holds the offsets.
+    std::vector<std::pair<uint32_t, int64_t>> index_;
+    std::vector<uint32_t> buckets_;
+    std::vector<uint8_t> strong_;
+
+    const uint8_t* seed_;
+    size_t seed_size_;
+    std::vector<DeltaCopy> copies_;
+    std::vector<std::pair<int64_t, int64_t>> missing_;
+    int64_t reused_bytes_;
+};
+
+}
+
+#endif
@@ -0,0 +1,202 @@
+#include "dns_resolver.h"
+#include "log.h"
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+#include <chrono>
+#include <thread>
+
+#define LOG_TAG "OrionDns"
+#define LOGD(...) orion::logPrint(orion::LogLevel::Debug, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) orion::logPrint(orion::LogLevel::Error, LOG_TAG, __VA_ARGS__)
+
+namespace orion {
+
+constexpr int64_t POSITIVE_TTL_MS = 60000;
+constexpr int64_t NEGATIVE_TTL_MS = 5000;
+constexpr int ATTEMPT_DELAY_MS = 250;
+
+static int64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+DnsResolver& DnsResolver::shared() {
+    static DnsResolver instance;
+    return instance;
+}
+
+DnsResolver::Entry DnsResolver::query(const std::string& host) {
+    Entry entry;
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_ADDRCONFIG;
+
+    struct addrinfo* result = nullptr;
+    int status = getaddrinfo(host.c_str(), nullptr, &hints, &result);
+    if (status != 0 || !result) {
+        LOGE("Failed to resolve host %s: %s", host.c_str(), gai_strerror(status));
+        entry.expires_ms = nowMs() + NEGATIVE_TTL_MS;
+        return entry;
+    }
+
+    std::vector<ResolvedAddress> v4, v6;
+    int first_family = result->ai_family;
+    for (struct addrinfo* ai = result; ai; ai = ai->ai_next) {
+        if (ai->ai_family != AF_INET && ai->ai_family != AF_INET6) continue;
+        ResolvedAddress address = {};
+        memcpy(&address.addr, ai->ai_addr, ai->ai_addrlen);
+        address.length = ai->ai_addrlen;
+        (ai->ai_family == AF_INET ? v4 : v6).push_back(address);
+    }
+    freeaddrinfo(result);
+
+    // Alternate families so a broken IPv6 path costs one attempt delay, not a timeout.
+    std::vector<ResolvedAddress>& first = first_family == AF_INET6 ? v6 : v4;
+    std::vector<ResolvedAddress>& second = first_family == AF_INET6 ? v4 : v6;
+    for (size_t i = 0; i < first.size() || i < second.size(); ++i) {
+        if (i < first.size()) entry.addresses.push_back(first[i]);
+        if (i < second.size()) entry.addresses.push_back(second[i]);
+    }
+
+    LOGD("Resolved %s: %zu IPv4, %zu IPv6", host.c_str(), v4.size(), v6.size());
+    entry.expires_ms = nowMs() + POSITIVE_TTL_MS;
+    return entry;
+}
+
+std::shared_future<DnsResolver::Entry> DnsResolver::lookup(const std::string& host) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto cached = cache_.find(host);
+    if (cached != cache_.end()) {
+        if (cached->second.expires_ms > nowMs()) {
+            std::promise<Entry> ready;
+            ready.set_value(cached->second);
+            return ready.get_future().share();
+        }
+        cache_.erase(cached);
+    }
+
+    auto pending = pending_.find(host);
+    if (pending != pending_.end()) {
+        return pending->second;
+    }
+
+    auto promise = std::make_shared<std::promise<Entry>>();
+    std::shared_future<Entry> future = promise->get_future().share();
+    pending_[host] = future;
+
+    std::thread([this, host, promise]() {
+        Entry entry = query(host);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cache_[host] = entry;
+            pending_.erase(host);
+        }
+        promise->set_value(std::move(entry));
+    }).detach();
+
+    return future;
+}
+
+bool DnsResolver::resolve(const std::string& host, int port,
+                          std::vector<ResolvedAddress>& addresses) {
+    Entry entry = lookup(host).get();
+    addresses = entry.addresses;
+
+    for (auto& address : addresses) {
+        if (address.addr.ss_family == AF_INET) {
+            reinterpret_cast<struct sockaddr_in*>(&address.addr)->sin_port = htons(port);
+        } else {
+            reinterpret_cast<struct sockaddr_in6*>(&address.addr)->sin6_port = htons(port);
+        }
+    }
+    return !addresses.empty();
+}
+
+void DnsResolver::prefetch(const std::string& host) {
+    lookup(host);
+}
+
+void DnsResolver::invalidate(const std::string& host) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache_.erase(host);
+}
+
+void DnsResolver::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache_.clear();
+}
+
+int connectAny(const std::vector<ResolvedAddress>& addresses, int timeout_ms) {
+    std::vector<struct pollfd> attempts;
+    size_t next = 0;
+    int64_t deadline = nowMs() + timeout_ms;
+    int64_t next_attempt_ms = 0;
+    int winner = -1;
+
+    while (winner < 0 && (next < addresses.size() || !attempts.empty())) {
+        int64_t now = nowMs();
+        if (now >= deadline) break;
+
+        if (next < addresses.size() && (attempts.empty() || now >= next_attempt_ms)) {
+            const ResolvedAddress& address = addresses[next++];
+            int fd = socket(address.addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd < 0) continue;
+            int result = connect(fd, reinterpret_cast<const struct sockaddr*>(&address.addr),
+                                 address.length);
+            if (result == 0) {
+                winner = fd;
+                break;
+            }
+            if (errno != EINPROGRESS) {
+                close(fd);
+                continue;
+            }
+            attempts.push_back({fd, POLLOUT, 0});
+            next_attempt_ms = now + ATTEMPT_DELAY_MS;
+        }
+
+        int64_t wait_until = deadline;
+        if (next < addresses.size()) wait_until = std::min(wait_until, next_attempt_ms);
+        int wait_ms = static_cast<int>(std::max<int64_t>(wait_until - nowMs(), 0));
+
+        int ready = poll(attempts.data(), attempts.size(), wait_ms);
+        if (ready < 0 && errno != EINTR) break;
+        if (ready <= 0) continue;
+
+        for (size_t i = 0; i < attempts.size();) {
+            if (attempts[i].revents == 0) {
+                ++i;
+                continue;
+            }
+            int error = 0;
+            socklen_t length = sizeof(error);
+            getsockopt(attempts[i].fd, SOL_SOCKET, SO_ERROR, &error, &length);
+            if (error == 0 && winner < 0) {
+                winner = attempts[i].fd;
+            } else {
+                close(attempts[i].fd);
+                // A failed attempt lets the next address start immediately.
+                next_attempt_ms = 0;
+            }
+            attempts.erase(attempts.begin() + i);
+        }
+    }
+
+    for (const auto& attempt : attempts) {
+        close(attempt.fd);
+    }
+    if (winner >= 0) {
+        fcntl(winner, F_SETFL, fcntl(winner, F_GETFL) & ~O_NONBLOCK);
+    }
+    return winner;
+}
+
+}
@@ -0,0 +1,55 @@
+#ifndef ORION_DNS_RESOLVER_H
+#define ORION_DNS_RESOLVER_H
+
+#include <cstdint>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+
+namespace orion {
+
+struct ResolvedAddress {
+    struct sockaddr_storage addr;
+    socklen_t length;
+};
+
+// Process-wide host name cache in front of getaddrinfo. Lookups for
+// different hosts run in parallel; concurrent lookups of the same host share
+// one query. getaddrinfo does not expose record TTLs, so positive answers
+// are kept for a fixed minute and failures for a few seconds.
+class DnsResolver {
+public:
+    static DnsResolver& shared();
+
+    // Returns addresses with the port filled in, A and AAAA records
+    // interleaved by family starting with the system's preferred one.
+    bool resolve(const std::string& host, int port, std::vector<ResolvedAddress>& addresses);
+    void prefetch(const std::string& host);
+    void invalidate(const std::string& host);
+    void clear();
+
+private:
+    struct Entry {
+        std::vector<ResolvedAddress> addresses;
+        int64_t expires_ms;
+    };
+
+    std::shared_future<Entry> lookup(const std::string& host);
+    static Entry query(const std::string& host);
+
+    std::mutex mutex_;
+    std::map<std::string, Entry> cache_;
+    std::map<std::string, std::shared_future<Entry>> pending_;
+};
+
+// Happy-eyeballs connect (RFC 8305): starts the next address every 250 ms
+// or as soon as an attempt fails, and keeps the first socket to connect.
+// Returns a blocking socket, or -1 once every address failed or timed out.
+int connectAny(const std::vector<ResolvedAddress>& addresses, int timeout_ms);
+
+}
+
+#endif
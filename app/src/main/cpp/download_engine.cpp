@@ -1,41 +1,86 @@
 #include "download_engine.h"
-#include <android/log.h>
+#include "event_loop.h"
+#include "connection_pool.h"
+#include "http_response.h"
+#include "dns_resolver.h"
+#include "progress_reporter.h"
+#include "progress_board.h"
+#include "delta_sync.h"
+#include "log.h"
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
-#include <netdb.h>
+#include <sys/epoll.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/statvfs.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstdint>
 #include <cstring>
 #include <sstream>
-#include <fstream>
 #include <chrono>
 #include <algorithm>
+#include <cmath>
+#include <random>
 
 #define LOG_TAG "OrionNative"
-#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
-#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGD(...) orion::logPrint(orion::LogLevel::Debug, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) orion::logPrint(orion::LogLevel::Error, LOG_TAG, __VA_ARGS__)
+#define LOGI(...) orion::logPrint(orion::LogLevel::Info, LOG_TAG, __VA_ARGS__)
 
 namespace orion {
 
 constexpr size_t BUFFER_SIZE = 65536;
 constexpr int CONNECT_TIMEOUT = 10;
+constexpr int64_t DRAIN_LIMIT = 64 * 1024;
+constexpr int64_t PROBE_SPAN = 1024 * 1024;
+constexpr int MAX_REDIRECTS = 5;
+constexpr int64_t ADDRESS_TIMEOUT_MS = 2000;
+constexpr int64_t THROTTLE_SLICE_US = 100000;
+constexpr double SPEED_TIME_CONSTANT_MS = 2000.0;
+// Consecutive failed attempts a connection makes without moving any bytes.
+constexpr int MAX_SEGMENT_RETRIES = 6;
+constexpr int64_t RETRY_BASE_MS = 250;
+constexpr int64_t RETRY_MAX_MS = 8000;
 
 DownloadEngine::DownloadEngine()
     : is_downloading_(false)
     , is_paused_(false)
     , should_cancel_(false)
     , total_bytes_(0)
-    , downloaded_bytes_(0)
+    , resumed_bytes_(0)
+    , decoded_bytes_(0)
+    , reused_bytes_(0)
+    , outcome_(static_cast<int>(DownloadOutcome::None))
+    , failure_reason_(static_cast<int>(FailureReason::None))
+    , http_status_(0)
+    , retries_(0)
     , current_speed_(0.0)
-    , num_connections_(8) {
+    , eta_seconds_(-1)
+    , sample_bytes_(0)
+    , sample_ms_(0)
+    , progress_slot_(ProgressBoard::shared().acquire())
+    , active_connections_(0)
+    , splice_enabled_(false)
+    , parks_workers_(false)
+    , num_connections_(8)
+    , adaptive_(false)
+    , output_fd_(-1)
+    , supports_ranges_(false)
+    , streaming_(false)
+    , stream_complete_(false)
+    , live_connections_(0)
+    , next_connection_id_(0)
+    , async_running_(false) {
     LOGI("DownloadEngine created (HTTP-only, no SSL)");
 }
 
 DownloadEngine::~DownloadEngine() {
     cancelDownload();
+    ProgressReporter::shared().remove(this);
+    ProgressBoard::shared().release(progress_slot_);
 }
 
 static bool parseUrl(const std::string& url, std::string& host, std::string& path, 
@@ -73,45 +118,6 @@ static bool parseUrl(const std::string& url, std::string& host, std::string& pat
     return true;
 }
 
-static int createConnection(const std::string& host, int port) {
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd < 0) {
-        LOGE("Failed to create socket");
-        return -1;
-    }
-
-    struct timeval timeout;
-    timeout.tv_sec = CONNECT_TIMEOUT;
-    timeout.tv_usec = 0;
-    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
-    setsockopt(sockfd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
-
-    int flag = 1;
-    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
-
-    struct hostent* server = gethostbyname(host.c_str());
-    if (server == nullptr) {
-        LOGE("Failed to resolve host: %s", host.c_str());
-        close(sockfd);
-        return -1;
-    }
-
-    struct sockaddr_in serv_addr;
-    memset(&serv_addr, 0, sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
-    memcpy(&serv_addr.sin_addr.s_addr, server->h_addr, server->h_length);
-    serv_addr.sin_port = htons(port);
-
-    if (connect(sockfd, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) {
-        LOGE("Failed to connect to %s:%d", host.c_str(), port);
-        close(sockfd);
-        return -1;
-    }
-
-    LOGD("Connected to %s:%d", host.c_str(), port);
-    return sockfd;
-}
-
 static bool sendRequest(int sockfd, const std::string& request) {
     size_t total_sent = 0;
     while (total_sent < request.length()) {
@@ -126,326 +132,2285 @@ static bool sendRequest(int sockfd, const std::string& request) {
     return true;
 }
 
-static std::string receiveHeaders(int sockfd) {
-    std::string headers;
-    char buffer[1];
-    std::string delimiter = "\r\n\r\n";
-    
-    while (headers.find(delimiter) == std::string::npos) {
-        ssize_t received = recv(sockfd, buffer, 1, 0);
-        if (received <= 0) {
-            break;
-        }
-        headers += buffer[0];
-        
-        if (headers.length() > 16384) {
-            break;
-        }
-    }
-    
-    return headers;
+static_assert(BufferArena::BUFFER_SIZE == BUFFER_SIZE, "arena buffers replace the receive buffer");
+
+static char* receiveBuffer(HttpConnection& connection) {
+    return connection.arena_buffer >= 0 ? connection.arena->data(connection.arena_buffer)
+                                        : connection.buffer.data();
 }
 
-int64_t DownloadEngine::getContentLength(const std::string& url) {
-    std::string host, path;
-    int port;
-    bool is_https;
-    
-    if (!parseUrl(url, host, path, port, is_https)) {
-        return -1;
+static ssize_t fillBuffer(HttpConnection& connection, size_t limit = SIZE_MAX) {
+    if (connection.buffer_start < connection.buffer_end) {
+        return static_cast<ssize_t>(connection.buffer_end - connection.buffer_start);
     }
-
-    int sockfd = createConnection(host, port);
-    if (sockfd < 0) {
-        return -1;
+    // A buffer the writer still references is left to it; take a fresh one,
+    // waiting for the writer when all are in flight.
+    if (connection.arena &&
+        (connection.arena_buffer < 0 || !connection.arena->exclusive(connection.arena_buffer))) {
+        if (connection.arena_buffer >= 0) connection.arena->release(connection.arena_buffer);
+        connection.arena_buffer = connection.arena->acquire();
+        if (connection.arena_buffer < 0) return -1;
     }
+    ssize_t received = recv(connection.fd, receiveBuffer(connection),
+                            std::min(connection.buffer.size(), limit), 0);
+    if (received > 0) {
+        connection.buffer_start = 0;
+        connection.buffer_end = received;
+    }
+    return received;
+}
 
-    std::ostringstream request;
-    request << "HEAD " << path << " HTTP/1.1\r\n"
-            << "Host: " << host << "\r\n"
-            << "User-Agent: Orion-Downloader/1.0\r\n"
-            << "Connection: close\r\n"
-            << "\r\n";
+static size_t feedParser(HttpConnection& connection, HttpResponseParser& parser,
+                         const char*& body, size_t& body_length) {
+    size_t used = parser.feed(receiveBuffer(connection) + connection.buffer_start,
+                              connection.buffer_end - connection.buffer_start,
+                              body, body_length);
+    connection.buffer_start += used;
+    return used;
+}
 
-    if (!sendRequest(sockfd, request.str())) {
-        close(sockfd);
-        return -1;
+static bool readResponseHead(HttpConnection& connection, HttpResponseParser& parser,
+                             bool& started) {
+    while (!parser.headersComplete()) {
+        if (fillBuffer(connection) <= 0) return false;
+        started = true;
+
+        const char* body;
+        size_t body_length;
+        feedParser(connection, parser, body, body_length);
+        if (parser.failed()) {
+            LOGE("Malformed HTTP response headers");
+            return false;
+        }
     }
+    return true;
+}
 
-    std::string headers = receiveHeaders(sockfd);
-    close(sockfd);
-    
-    std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
-    size_t pos = headers.find("content-length:");
-    
-    if (pos != std::string::npos) {
-        size_t end = headers.find("\r\n", pos);
-        std::string length_str = headers.substr(pos + 15, end - pos - 15);
-        length_str.erase(0, length_str.find_first_not_of(" \t"));
-        return std::stoll(length_str);
+static bool drainResponse(HttpConnection& connection) {
+    HttpResponseParser& parser = connection.parser;
+    int64_t left = parser.remaining();
+    if (!connection.reusable || left > DRAIN_LIMIT || (left < 0 && !parser.response().chunked)) {
+        return parser.done();
     }
 
-    return -1;
+    const char* body;
+    size_t body_length;
+    int64_t drained = 0;
+    while (!parser.done() && !parser.failed() && drained <= DRAIN_LIMIT &&
+           fillBuffer(connection) > 0) {
+        drained += feedParser(connection, parser, body, body_length);
+    }
+    return parser.done();
 }
 
-bool DownloadEngine::supportsRangeRequests(const std::string& url) {
-    std::string host, path;
-    int port;
-    bool is_https;
-    
-    if (!parseUrl(url, host, path, port, is_https)) {
-        return false;
+// Parses "bytes first-last/total"; total is -1 when the server sent "*".
+static bool parseContentRange(const std::string& value, int64_t& first, int64_t& last,
+                              int64_t& total) {
+    if (value.compare(0, 6, "bytes ") != 0) return false;
+    size_t slash = value.find('/', 6);
+    if (slash == std::string::npos) return false;
+
+    first = last = -1;
+    if (value[6] != '*') {
+        char* end = nullptr;
+        first = strtoll(value.c_str() + 6, &end, 10);
+        if (*end != '-') return false;
+        last = strtoll(end + 1, &end, 10);
+        if (end != value.c_str() + slash) return false;
     }
+    total = value[slash + 1] == '*' ? -1 : strtoll(value.c_str() + slash + 1, nullptr, 10);
+    return true;
+}
 
-    int sockfd = createConnection(host, port);
-    if (sockfd < 0) {
-        return false;
+static std::string resolveLocation(const std::string& location, const std::string& host,
+                                   int port, const std::string& path) {
+    if (location.find("://") != std::string::npos) return location;
+
+    std::string origin = "http://" + host;
+    if (port != 80) origin += ":" + std::to_string(port);
+    if (!location.empty() && location[0] == '/') return origin + location;
+    return origin + path.substr(0, path.rfind('/') + 1) + location;
+}
+
+static std::string lowercase(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+    return value;
+}
+
+static std::string buildGetRequest(const std::string& host, const std::string& path,
+                                   bool accept_compressed = false) {
+    std::ostringstream request;
+    request << "GET " << path << " HTTP/1.1\r\n"
+            << "Host: " << host << "\r\n"
+            << "User-Agent: Orion-Downloader/1.0\r\n";
+    if (accept_compressed) {
+        request << "Accept-Encoding: gzip, deflate\r\n";
     }
+    request << "\r\n";
+    return request.str();
+}
 
+static std::string buildRangeRequest(const std::string& host, const std::string& path,
+                                     int64_t first, int64_t last) {
     std::ostringstream request;
-    request << "HEAD " << path << " HTTP/1.1\r\n"
+    request << "GET " << path << " HTTP/1.1\r\n"
             << "Host: " << host << "\r\n"
             << "User-Agent: Orion-Downloader/1.0\r\n"
-            << "Connection: close\r\n"
+            << "Range: bytes=" << first << "-" << last << "\r\n"
             << "\r\n";
+    return request.str();
+}
+
+// Probes with a ranged GET rather than HEAD: one round trip yields the
+// length, range support and validators, and with a handoff the response
+// body continues as the first segment instead of being thrown away.
+bool DownloadEngine::probeResource(const std::string& url, ResourceInfo& info, int64_t span,
+                                   HttpConnection* handoff, ConnectionTimings* timings) {
+    std::string current = url;
+
+    for (int redirects = 0; redirects <= MAX_REDIRECTS; ++redirects) {
+        HttpConnection connection;
+        connection.timings = timings;
+        bool is_https;
+        if (!parseUrl(current, connection.host, connection.path, connection.port, is_https)) {
+            return false;
+        }
+
+        std::string request = buildRangeRequest(connection.host, connection.path, 0, span - 1);
+        if (!openResponse(connection, request, false, false)) {
+            return false;
+        }
+
+        const HttpResponse& response = connection.parser.response();
+        const std::string& location = response.header("location");
+        if (response.status >= 300 && response.status < 400 && !location.empty()) {
+            ConnectionPool::shared().release(connection.host, connection.port, connection.fd,
+                                             drainResponse(connection));
+            current = resolveLocation(location, connection.host, connection.port,
+                                      connection.path);
+            LOGD("Redirected to %s", current.c_str());
+            continue;
+        }
+
+        int64_t first, last, total = -1;
+        bool has_range = parseContentRange(response.header("content-range"), first, last, total);
+        if (response.status == 206 && has_range) {
+            info.content_length = total;
+            info.supports_ranges = true;
+        } else if (response.status == 416 && has_range) {
+            info.content_length = total;
+            info.supports_ranges = true;
+        } else if (response.status >= 200 && response.status < 300) {
+            info.content_length = response.content_length;
+            info.supports_ranges = lowercase(response.header("accept-ranges")) == "bytes";
+        } else {
+            LOGE("Probe of %s failed with HTTP status %d", current.c_str(), response.status);
+            dropConnection(connection);
+            return false;
+        }
 
-    if (!sendRequest(sockfd, request.str())) {
-        close(sockfd);
+        info.final_url = current;
+        info.etag = response.header("etag");
+        info.last_modified = response.header("last-modified");
+        info.content_type = response.header("content-type");
+
+        bool has_body = response.status == 206 || response.status == 200;
+        if (handoff && has_body && !connection.parser.done()) {
+            connection.response_open = true;
+            *handoff = std::move(connection);
+            return true;
+        }
+
+        ConnectionPool::shared().release(connection.host, connection.port, connection.fd,
+                                         drainResponse(connection) &&
+                                         connection.buffer_start == connection.buffer_end);
+        return true;
+    }
+
+    LOGE("Too many redirects for %s", url.c_str());
+    return false;
+}
+
+bool DownloadEngine::probe(const std::string& url, ResourceInfo& info) {
+    if (MetadataCache::shared().lookup(url, info)) {
+        return true;
+    }
+    if (!probeResource(url, info, 1, nullptr)) {
         return false;
     }
+    MetadataCache::shared().store(url, info);
+    return true;
+}
 
-    std::string headers = receiveHeaders(sockfd);
-    close(sockfd);
-    
-    std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+int64_t DownloadEngine::getContentLength(const std::string& url) {
+    ResourceInfo info;
+    if (!probe(url, info)) {
+        return -1;
+    }
+    return info.content_length;
+}
 
-    return headers.find("accept-ranges: bytes") != std::string::npos;
+bool DownloadEngine::supportsRangeRequests(const std::string& url) {
+    ResourceInfo info;
+    if (!probe(url, info)) {
+        return false;
+    }
+    return info.supports_ranges;
 }
 
 bool DownloadEngine::initializeDownload(const std::string& url) {
-    int64_t content_length = getContentLength(url);
-    if (content_length <= 0) {
-        LOGE("Failed to get content length");
+    ResourceInfo info;
+    // The event loop opens its own sockets, so only threaded downloads can
+    // continue on the probe connection. With local validators or a delta
+    // manifest the local copy may make the body unnecessary, so the probe
+    // asks for one byte instead.
+    bool handoff = options_.io_backend == IoBackend::Threaded && !options_.decompress &&
+                   options_.delta_manifest_url.empty() && options_.local_etag.empty() &&
+                   options_.local_last_modified.empty();
+    bool cached = MetadataCache::shared().lookup(url, info);
+    if (!cached) {
+        // Recorded as connection -1.
+        if (!probeResource(url, info, handoff ? PROBE_SPAN : 1,
+                           handoff ? &probe_connection_ : nullptr, stats_.open(-1))) {
+            LOGE("Failed to probe %s", url.c_str());
+            return false;
+        }
+        MetadataCache::shared().store(url, info);
+    }
+
+    int64_t content_length = info.content_length;
+    bool supports_ranges = info.supports_ranges;
+    remote_etag_ = info.etag;
+    remote_last_modified_ = info.last_modified;
+    source_url_ = url;
+    url_ = info.final_url;
+    mirrors_.clear();
+    if (!addMirror(url_, remote_etag_)) {
         return false;
     }
 
+    // A compressed body has no byte ranges in the decoded file, so it is
+    // fetched as one stream too.
+    streaming_ = content_length < 0 || options_.decompress;
+    stream_complete_ = false;
+
+    if (streaming_) {
+        LOGI(options_.decompress ? "Negotiating compression, streaming over a single connection"
+                                 : "Content length unknown, streaming over a single connection");
+        total_bytes_.store(-1);
+        supports_ranges_ = false;
+        num_connections_ = 1;
+        adaptive_ = false;
+        scheduler_.reset(0, 1, false);
+        return true;
+    }
+
     total_bytes_.store(content_length);
-    downloaded_bytes_.store(0);
+    supports_ranges_ = supports_ranges;
 
-    bool supports_ranges = supportsRangeRequests(url);
     int actual_connections = supports_ranges ? num_connections_ : 1;
+    adaptive_ = adaptive_ && supports_ranges;
+    if (supports_ranges && !options_.mirrors.empty()) {
+        probeMirrors(info);
+    }
 
     LOGI("Content: %lld bytes, Connections: %d, HTTP-only", 
          (long long)content_length, actual_connections);
 
-    chunks_.clear();
-    
-    if (actual_connections == 1) {
-        chunks_.push_back({0, content_length - 1, 0, false});
-    } else {
-        int64_t chunk_size = content_length / actual_connections;
-        for (int i = 0; i < actual_connections; ++i) {
-            int64_t start = i * chunk_size;
-            int64_t end = (i == actual_connections - 1) ? 
-                         content_length - 1 : (start + chunk_size - 1);
-            chunks_.push_back({start, end, 0, false});
+    num_connections_ = actual_connections;
+    int64_t first_segment = probe_connection_.response_open ? PROBE_SPAN : 0;
+    scheduler_.reset(content_length, actual_connections, supports_ranges, first_segment);
+    scheduler_.setEndgame(options_.endgame_bytes);
+
+    if (probe_connection_.response_open) {
+        probe_connection_.has_pipelined =
+            scheduler_.acquire(0, probe_connection_.pipelined);
+        if (!probe_connection_.has_pipelined) {
+            dropConnection(probe_connection_);
         }
     }
-
     return true;
 }
 
-void DownloadEngine::downloadChunk(int chunk_id, const std::string& url, 
-                                   const std::string& output_path) {
-    if (chunk_id >= static_cast<int>(chunks_.size())) return;
-
-    auto& chunk = chunks_[chunk_id];
-    std::string host, path;
-    int port;
+bool DownloadEngine::addMirror(const std::string& url, const std::string& etag) {
+    Mirror mirror;
     bool is_https;
-    
-    if (!parseUrl(url, host, path, port, is_https)) {
-        LOGE("Failed to parse URL for chunk %d", chunk_id);
-        return;
+    if (!parseUrl(url, mirror.host, mirror.path, mirror.port, is_https)) {
+        return false;
     }
+    mirror.url = url;
+    mirror.etag = etag;
+    mirrors_.add(mirror);
+    return true;
+}
 
-    std::string temp_file = output_path + ".part" + std::to_string(chunk_id);
-    std::ofstream out(temp_file, std::ios::binary);
-    if (!out) {
-        LOGE("Failed to open temp file: %s", temp_file.c_str());
-        return;
+// A mirror has to serve the same entity: the same length, ranges, and the
+// same ETag, or failing that Last-Modified, when both sides send one. The
+// probes run side by side so each mirror costs one round trip in total.
+void DownloadEngine::probeMirrors(const ResourceInfo& primary) {
+    const std::vector<std::string>& urls = options_.mirrors;
+    std::vector<ResourceInfo> infos(urls.size());
+    std::vector<char> probed(urls.size(), 0);
+    std::vector<std::thread> probes;
+    for (size_t i = 0; i < urls.size(); ++i) {
+        probes.emplace_back([this, &urls, &infos, &probed, i]() {
+            probed[i] = probe(urls[i], infos[i]);
+        });
+    }
+    for (std::thread& thread : probes) {
+        thread.join();
     }
 
-    int sockfd = createConnection(host, port);
-    if (sockfd < 0) {
-        out.close();
-        return;
+    bool has_validator = !primary.etag.empty() || !primary.last_modified.empty();
+    for (size_t i = 0; i < urls.size(); ++i) {
+        const ResourceInfo& info = infos[i];
+        bool same = probed[i] && info.supports_ranges &&
+            info.content_length == primary.content_length;
+        if (same && !primary.etag.empty() && !info.etag.empty()) {
+            same = info.etag == primary.etag;
+        } else if (same && !primary.last_modified.empty() && !info.last_modified.empty()) {
+            same = info.last_modified == primary.last_modified;
+        } else if (same) {
+            same = !has_validator;
+        }
+        if (!same || !addMirror(info.final_url, info.etag)) {
+            LOGE("Skipping mirror %s: %s", urls[i].c_str(),
+                 probed[i] ? "does not match the primary" : "probe failed");
+        }
     }
+    LOGI("Downloading from %zu sources", mirrors_.size());
+}
 
-    std::ostringstream request;
-    request << "GET " << path << " HTTP/1.1\r\n"
-            << "Host: " << host << "\r\n"
-            << "User-Agent: Orion-Downloader/1.0\r\n"
-            << "Range: bytes=" << chunk.start << "-" << chunk.end << "\r\n"
-            << "Connection: close\r\n"
-            << "\r\n";
+static bool writeAt(int fd, const char* data, size_t length, int64_t offset) {
+    while (length > 0) {
+        ssize_t written = pwrite(fd, data, length, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        length -= written;
+        offset += written;
+    }
+    return true;
+}
 
-    if (!sendRequest(sockfd, request.str())) {
-        close(sockfd);
-        out.close();
-        return;
+static bool timedWrite(int fd, const char* data, size_t length, int64_t offset,
+                       ConnectionTimings* timings) {
+    if (!timings) {
+        return writeAt(fd, data, length, offset);
     }
+    int64_t started_us = StatsRecorder::nowUs();
+    bool ok = writeAt(fd, data, length, offset);
+    timings->recordWrite(static_cast<int64_t>(length), StatsRecorder::nowUs() - started_us);
+    return ok;
+}
 
-    std::string headers = receiveHeaders(sockfd);
-    
-    char buffer[BUFFER_SIZE];
-    auto start_time = std::chrono::steady_clock::now();
-    int64_t chunk_downloaded = 0;
+bool DownloadEngine::prepareOutputFile(const std::string& output_path, int64_t size,
+                                       bool keep_existing) {
+    int fd = open(output_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOGE("Failed to open output file: %s (%s)", output_path.c_str(), strerror(errno));
+        return false;
+    }
 
-    while (!should_cancel_.load()) {
-        while (is_paused_.load() && !should_cancel_.load()) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (keep_existing) {
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size != size) {
+            LOGE("Existing output does not match journal, cannot resume");
+            close(fd);
+            return false;
         }
+        output_fd_ = fd;
+        return true;
+    }
 
-        ssize_t received = recv(sockfd, buffer, BUFFER_SIZE, 0);
-        if (received <= 0) break;
+    // Checked before truncating, so a download that cannot fit leaves the
+    // existing file alone. Its blocks come back once it is truncated.
+    struct stat st;
+    struct statvfs fs;
+    if (size > 0 && fstat(fd, &st) == 0 && fstatvfs(fd, &fs) == 0) {
+        int64_t available = static_cast<int64_t>(fs.f_bavail) * static_cast<int64_t>(fs.f_frsize) +
+                            static_cast<int64_t>(st.st_blocks) * 512;
+        if (available < size) {
+            LOGE("Not enough free space: need %lld bytes, have %lld",
+                 (long long)size, (long long)available);
+            close(fd);
+            return false;
+        }
+    }
 
-        out.write(buffer, received);
-        chunk.downloaded += received;
-        chunk_downloaded += received;
-        downloaded_bytes_.fetch_add(received);
+    if (ftruncate(fd, 0) != 0) {
+        LOGE("Failed to truncate output file: %s", strerror(errno));
+        close(fd);
+        return false;
+    }
 
-        auto current_time = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-            current_time - start_time).count();
-        
-        if (elapsed > 0) {
-            double speed = (chunk_downloaded * 1000.0) / elapsed;
-            current_speed_.store(speed);
-        }
+    if (size < 0) {
+        output_fd_ = fd;
+        return true;
+    }
 
-        if (progress_callback_ && elapsed > 100) {
-            DownloadProgress progress = getProgress();
-            progress_callback_(progress);
-            start_time = current_time;
-            chunk_downloaded = 0;
+    if (fallocate(fd, 0, 0, static_cast<off_t>(size)) != 0) {
+        LOGD("fallocate unavailable (%s), using sparse file", strerror(errno));
+        if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            LOGE("Failed to size output file: %s", strerror(errno));
+            close(fd);
+            return false;
         }
     }
 
-    close(sockfd);
-    out.close();
+    output_fd_ = fd;
+    return true;
+}
 
-    if (!should_cancel_.load()) {
-        chunk.completed = true;
-        LOGD("Chunk %d completed", chunk_id);
+void DownloadEngine::closeOutputFile() {
+    if (output_fd_ >= 0) {
+        close(output_fd_);
+        output_fd_ = -1;
     }
 }
 
-void DownloadEngine::mergeChunks(const std::string& output_path) {
-    std::ofstream out(output_path, std::ios::binary);
-    if (!out) {
-        LOGE("Failed to open output file: %s", output_path.c_str());
-        return;
+bool DownloadEngine::runConnection(int connection_id) {
+    HttpConnection connection;
+    // Connection 0 continues the response the metadata probe left open.
+    if (connection_id == 0 && probe_connection_.fd >= 0) {
+        connection = std::move(probe_connection_);
+        probe_connection_ = HttpConnection();
+        connection.mirror = 0;
+        mirrors_.join(0);
+    } else if (!chooseMirror(connection)) {
+        LOGE("No source left for connection %d", connection_id);
+        return false;
+    }
+    connection.timings = stats_.open(connection_id);
+    if (write_behind_.running()) {
+        connection.arena = &write_behind_.arena();
     }
 
-    for (size_t i = 0; i < chunks_.size(); ++i) {
-        std::string temp_file = output_path + ".part" + std::to_string(i);
-        std::ifstream in(temp_file, std::ios::binary);
-        if (!in) {
-            LOGE("Failed to open temp file: %s", temp_file.c_str());
+    active_connections_.fetch_add(1);
+
+    bool ok = true;
+    bool retired = false;
+    SegmentLease lease;
+    if (streaming_) {
+        if (connection_id == 0) {
+            ok = streamBody(connection_id, connection) || should_cancel_.load();
+        }
+    }
+    int attempts = 0;
+    while (!streaming_ && !should_cancel_.load()) {
+        if (is_paused_.load()) {
+            // A DownloadManager job hands its pool thread back and is granted
+            // connections again on resume.
+            dropConnection(connection);
+            if (!parks_workers_) break;
+            waitWhilePaused();
             continue;
         }
 
-        char buffer[BUFFER_SIZE];
-        while (in.read(buffer, BUFFER_SIZE) || in.gcount() > 0) {
-            out.write(buffer, in.gcount());
+        bool request_sent = connection.has_pipelined;
+        if (connection.has_pipelined) {
+            lease = connection.pipelined;
+            connection.has_pipelined = false;
+        } else if (retireConnection()) {
+            retired = true;
+            break;
+        } else if (!chooseMirror(connection) || !scheduler_.acquire(connection_id, lease)) {
+            break;
+        }
+
+        int64_t consumed = connection.body_bytes;
+        int64_t started_us = StatsRecorder::nowUs();
+        if (!downloadSegment(connection_id, lease, connection, request_sent)) {
+            scheduler_.release(lease.segment_id);
+            // Paused mid-segment: the lease keeps its progress, and the next
+            // request asks for start + downloaded.
+            if (is_paused_.load() && !should_cancel_.load()) continue;
+            if (should_cancel_.load()) break;
+
+            // Retries pick the segment up again from its last written byte.
+            tuner_.onConnectionError();
+            if (connection.body_bytes > consumed) {
+                attempts = 0;
+                mirrors_.recordSuccess(connection.mirror, connection.body_bytes - consumed,
+                                       (StatsRecorder::nowUs() - started_us) / 1000);
+            } else if (mirrors_.recordFailure(connection.mirror)) {
+                // The rest of the segment goes straight to another mirror.
+                attempts = 0;
+                continue;
+            }
+            if (attempts < MAX_SEGMENT_RETRIES) {
+                waitBeforeRetry(attempts++);
+                continue;
+            }
+            LOGE("Connection %d giving up after %d retries", connection_id, attempts);
+            int none = static_cast<int>(FailureReason::None);
+            failure_reason_.compare_exchange_strong(none, static_cast<int>(FailureReason::Network));
+            ok = false;
+            break;
         }
-        in.close();
-        unlink(temp_file.c_str());
+        attempts = 0;
+        mirrors_.recordSuccess(connection.mirror, connection.body_bytes - consumed,
+                               (StatsRecorder::nowUs() - started_us) / 1000);
     }
 
-    out.close();
-    LOGI("Chunks merged successfully");
+    if (connection.has_pipelined) {
+        scheduler_.release(connection.pipelined.segment_id);
+        connection.reusable = false;
+    }
+    ConnectionPool::shared().release(connection.host, connection.port, connection.fd,
+                                     connection.reusable &&
+                                     connection.buffer_start == connection.buffer_end);
+    if (connection.arena_buffer >= 0) {
+        connection.arena->release(connection.arena_buffer);
+    }
+    mirrors_.leave(connection.mirror);
+
+    active_connections_.fetch_sub(1);
+    if (adaptive_ && !retired) {
+        live_connections_.fetch_sub(1);
+    }
+    return ok;
 }
 
-bool DownloadEngine::startDownload(const std::string& url, 
-                                   const std::string& output_path,
-                                   int num_connections,
-                                   ProgressCallback progress_callback) {
-    if (is_downloading_.load()) {
-        LOGE("Download already in progress");
+bool DownloadEngine::consumeBody(int connection_id, const SegmentLease& lease,
+                                 const char* data, size_t length, bool& finished,
+                                 ConnectionTimings* timings, int arena_buffer) {
+    int64_t offset = 0;
+    int64_t skipped = 0;
+    int64_t granted = scheduler_.take(lease.segment_id, length, offset, finished, skipped);
+    data += skipped;
+    if (finished) {
+        stopTwin(lease.segment_id);
+    }
+    if (granted == 0) {
+        return true;
+    }
+
+    if (arena_buffer >= 0) {
+        if (!write_behind_.submit(arena_buffer, data, static_cast<size_t>(granted), offset)) {
+            LOGE("Write-behind failed, stopping connection %d", connection_id);
+            fail(FailureReason::Storage);
+            return false;
+        }
+        recordBytes(connection_id, granted);
+        return true;
+    }
+
+    if (!timedWrite(output_fd_, data, granted, offset, timings)) {
+        LOGE("Write failed on connection %d: %s", connection_id, strerror(errno));
+        fail(FailureReason::Storage);
+        return false;
+    }
+    journal_.markWritten(offset, granted);
+    if (!verifyWritten(data, granted, offset)) {
         return false;
     }
+    journal_.flushIfDue(output_fd_);
+    recordBytes(connection_id, granted);
+    return true;
+}
 
-    num_connections_ = std::min(std::max(num_connections, 1), 16);
-    progress_callback_ = progress_callback;
-    should_cancel_.store(false);
-    is_paused_.store(false);
+// Runs on the writer thread once a queued span is in the page cache, so the
+// journal never claims bytes that were only received.
+void DownloadEngine::onWritten(const char* data, int64_t length, int64_t offset) {
+    journal_.markWritten(offset, length);
+    verifyWritten(data, length, offset);
+    journal_.flushIfDue(output_fd_);
+}
 
-    if (!initializeDownload(url)) {
+// Pieces that fail their manifest digest are forgotten by the journal and
+// handed back to the scheduler so a connection fetches them again.
+bool DownloadEngine::verifyWritten(const char* data, int64_t length, int64_t offset) {
+    std::vector<std::pair<int64_t, int64_t>> corrupt;
+    if (!verifier_.update(output_fd_, offset, data, static_cast<size_t>(length), corrupt)) {
+        LOGE("Integrity check failed at offset %lld, giving up", (long long)offset);
+        fail(FailureReason::Integrity);
         return false;
     }
+    for (const auto& range : corrupt) {
+        int64_t bytes = range.second - range.first + 1;
+        journal_.markMissing(range.first, bytes);
+        resumed_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+        scheduler_.requeue(range.first, range.second);
+    }
+    return true;
+}
+
+// Connection ids keep growing under DownloadManager, so two live connections
+// can share a slot; the add stays atomic for that case, but in the common
+// one the line is only ever written by its own thread.
+void DownloadEngine::recordBytes(int connection_id, int64_t bytes) {
+    counters_[connection_id % COUNTER_SLOTS].bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+int64_t DownloadEngine::downloadedBytes() const {
+    int64_t total = resumed_bytes_.load(std::memory_order_relaxed);
+    for (const ByteCounter& counter : counters_) {
+        total += counter.bytes.load(std::memory_order_relaxed);
+    }
+    return total;
+}
 
-    is_downloading_.store(true);
-    worker_threads_.clear();
+void DownloadEngine::beginProgress(int64_t resumed_bytes) {
+    for (ByteCounter& counter : counters_) {
+        counter.bytes.store(0, std::memory_order_relaxed);
+    }
+    resumed_bytes_.store(resumed_bytes);
+    decoded_bytes_.store(0);
+    outcome_.store(static_cast<int>(DownloadOutcome::None));
+    failure_reason_.store(static_cast<int>(FailureReason::None));
+    http_status_.store(0);
+    retries_.store(0);
+    current_speed_.store(0.0);
+    eta_seconds_.store(-1);
+    sample_bytes_ = resumed_bytes;
+    sample_ms_ = 0;
+    ProgressBoard::shared().publish(progress_slot_, getProgress(), true);
+    ProgressReporter::shared().add(this);
+}
 
-    for (size_t i = 0; i < chunks_.size(); ++i) {
-        worker_threads_.push_back(
-            std::make_unique<std::thread>(
-                &DownloadEngine::downloadChunk, this, i, url, output_path
-            )
-        );
+// Runs on the reporter thread only. The speed is an EWMA of the aggregate
+// rate with a fixed time constant, so uneven sample gaps weigh correctly.
+void DownloadEngine::sampleProgress(int64_t now_ms) {
+    int64_t downloaded = downloadedBytes();
+    if (sample_ms_ > 0 && now_ms > sample_ms_) {
+        double elapsed = static_cast<double>(now_ms - sample_ms_);
+        double rate = (downloaded - sample_bytes_) * 1000.0 / elapsed;
+        double alpha = 1.0 - std::exp(-elapsed / SPEED_TIME_CONSTANT_MS);
+        double speed = current_speed_.load();
+        current_speed_.store(speed + alpha * (rate - speed));
+    }
+    sample_ms_ = now_ms;
+    sample_bytes_ = downloaded;
+
+    double speed = current_speed_.load();
+    int64_t total = total_bytes_.load();
+    eta_seconds_.store(total >= 0 && speed >= 1.0
+                       ? static_cast<int64_t>((total - downloaded) / speed) : -1);
+
+    if (adaptive_) {
+        // Paused or throttled intervals measure the cap, not the link.
+        bool steady = !is_paused_.load() && !rate_limiter_.limited() &&
+                      !RateLimiter::global().limited();
+        tuner_.sample(now_ms, downloaded, steady);
+        adjustConnections();
     }
 
-    std::thread([this, output_path]() {
-        for (auto& thread : worker_threads_) {
-            if (thread && thread->joinable()) {
-                thread->join();
-            }
-        }
+    DownloadProgress progress = getProgress();
+    ProgressBoard::shared().publish(progress_slot_, progress, true);
+    if (progress_callback_) {
+        progress_callback_(progress);
+    }
+}
 
-        if (!should_cancel_.load()) {
-            mergeChunks(output_path);
-        }
+// Reserves up to wanted bytes from both the global and this download's
+// bucket. Unlimited buckets skip the reservation, so an unthrottled read
+// pays two relaxed loads.
+size_t DownloadEngine::admitRead(size_t wanted, int64_t& wait_us) {
+    RateLimiter& global = RateLimiter::global();
+    wait_us = 0;
+    if (!global.limited() && !rate_limiter_.limited()) {
+        return wanted;
+    }
+    size_t admitted = rate_limiter_.chunk(global.chunk(wanted));
+    wait_us = std::max(global.reserve(admitted), rate_limiter_.reserve(admitted));
+    return admitted;
+}
 
-        is_downloading_.store(false);
-        LOGI("Download completed");
-    }).detach();
+void DownloadEngine::settleRead(size_t admitted, ssize_t received) {
+    int64_t unused = static_cast<int64_t>(admitted) - std::max<ssize_t>(received, 0);
+    if (unused > 0) {
+        RateLimiter::global().refund(unused);
+        rate_limiter_.refund(unused);
+    }
+}
 
-    return true;
+// Sleeps in slices so a cancel is not held up by a long reservation.
+void DownloadEngine::throttle(int64_t wait_us, ConnectionTimings* timings) {
+    if (timings && wait_us > 0) {
+        timings->add(timings->throttle_us, wait_us);
+    }
+    while (wait_us > 0 && !should_cancel_.load() && !is_paused_.load()) {
+        int64_t slice = std::min(wait_us, THROTTLE_SLICE_US);
+        std::this_thread::sleep_for(std::chrono::microseconds(slice));
+        wait_us -= slice;
+    }
 }
 
-void DownloadEngine::pauseDownload() {
-    is_paused_.store(true);
-    LOGD("Download paused");
+ssize_t DownloadEngine::receive(HttpConnection& connection) {
+    if (connection.buffer_start < connection.buffer_end) {
+        return fillBuffer(connection);
+    }
+
+    int64_t wait_us;
+    size_t admitted = admitRead(connection.buffer.size(), wait_us);
+    ConnectionTimings* timings = connection.timings;
+    throttle(wait_us, timings);
+
+    int64_t started_us = timings ? StatsRecorder::nowUs() : 0;
+    ssize_t received = fillBuffer(connection, admitted);
+    if (timings) {
+        timings->recordRecv(received, StatsRecorder::nowUs() - started_us);
+    }
+    settleRead(admitted, received);
+    return received;
 }
 
-void DownloadEngine::resumeDownload() {
-    is_paused_.store(false);
-    LOGD("Download resumed");
+void DownloadEngine::setRateLimit(int64_t bytes_per_second) {
+    rate_limiter_.setRate(bytes_per_second);
 }
 
-void DownloadEngine::cancelDownload() {
-    should_cancel_.store(true);
-    is_paused_.store(false);
-    
-    for (auto& thread : worker_threads_) {
-        if (thread && thread->joinable()) {
-            thread->join();
-        }
+IntegrityResult DownloadEngine::getIntegrity() const {
+    return verifier_.result();
+}
+
+DownloadResult DownloadEngine::getResult() const {
+    DownloadResult result;
+    result.outcome = static_cast<DownloadOutcome>(outcome_.load());
+    result.reason = static_cast<FailureReason>(failure_reason_.load());
+    result.http_status = http_status_.load();
+    result.retries = retries_.load();
+    result.reused_bytes = reused_bytes_.load();
+    return result;
+}
+
+// Keeps the first reason; whatever fails after it is fallout.
+void DownloadEngine::fail(FailureReason reason) {
+    int none = static_cast<int>(FailureReason::None);
+    failure_reason_.compare_exchange_strong(none, static_cast<int>(reason));
+    {
+        std::lock_guard<std::mutex> lock(pause_mutex_);
+        should_cancel_.store(true);
     }
-    
-    worker_threads_.clear();
-    is_downloading_.store(false);
-    LOGD("Download cancelled");
+    pause_cv_.notify_all();
+}
+
+// A random delay in the upper half of an exponential ceiling, so connections
+// that failed together do not come back together.
+int64_t DownloadEngine::nextRetryDelay(int attempt) {
+    thread_local std::minstd_rand rng(std::random_device{}());
+    retries_.fetch_add(1);
+    int64_t ceiling = std::min(RETRY_BASE_MS << std::min(attempt, 10), RETRY_MAX_MS);
+    return ceiling / 2 + static_cast<int64_t>(rng() % static_cast<uint32_t>(ceiling / 2 + 1));
+}
+
+void DownloadEngine::waitBeforeRetry(int attempt) {
+    std::chrono::milliseconds delay(nextRetryDelay(attempt));
+    std::unique_lock<std::mutex> lock(pause_mutex_);
+    pause_cv_.wait_for(lock, delay, [this] {
+        return should_cancel_.load() || is_paused_.load();
+    });
+}
+
+DownloadStats DownloadEngine::getStats() const {
+    DownloadStats stats = stats_.snapshot();
+    stats.hedges = scheduler_.hedges();
+    stats.hedges_won = scheduler_.hedgesWon();
+    stats.hedge_wasted_bytes = scheduler_.wastedBytes();
+    return stats;
+}
+
+void DownloadEngine::setGlobalRateLimit(int64_t bytes_per_second) {
+    RateLimiter::global().setRate(bytes_per_second);
+    LOGI("Global rate limit set to %lld B/s", (long long)bytes_per_second);
+}
+
+void DownloadEngine::dropConnection(HttpConnection& connection) {
+    if (connection.fd >= 0) {
+        close(connection.fd);
+        connection.fd = -1;
+    }
+    connection.reusable = false;
+    connection.response_open = false;
+    connection.buffer_start = 0;
+    connection.buffer_end = 0;
+    if (connection.has_pipelined) {
+        scheduler_.release(connection.pipelined.segment_id);
+        connection.has_pipelined = false;
+    }
+}
+
+// Reads a small resource whole, following redirects as the probe does.
+bool DownloadEngine::fetchBody(const std::string& url, std::string& body, size_t limit) {
+    std::string current = url;
+
+    for (int redirects = 0; redirects <= MAX_REDIRECTS; ++redirects) {
+        HttpConnection connection;
+        bool is_https;
+        if (!parseUrl(current, connection.host, connection.path, connection.port, is_https) ||
+            !openResponse(connection, buildGetRequest(connection.host, connection.path),
+                          false, false)) {
+            return false;
+        }
+
+        HttpResponseParser& parser = connection.parser;
+        const HttpResponse& response = parser.response();
+        const std::string& location = response.header("location");
+        if (response.status >= 300 && response.status < 400 && !location.empty()) {
+            ConnectionPool::shared().release(connection.host, connection.port, connection.fd,
+                                             drainResponse(connection));
+            current = resolveLocation(location, connection.host, connection.port,
+                                      connection.path);
+            continue;
+        }
+        if (response.status != 200 || response.content_length > static_cast<int64_t>(limit)) {
+            LOGE("Cannot fetch %s: HTTP status %d, %lld bytes", current.c_str(),
+                 response.status, (long long)response.content_length);
+            dropConnection(connection);
+            return false;
+        }
+
+        body.clear();
+        const char* data;
+        size_t length;
+        while (!parser.done()) {
+            ssize_t available = fillBuffer(connection);
+            if (available <= 0) {
+                if (available == 0) parser.finishOnClose();
+                break;
+            }
+            feedParser(connection, parser, data, length);
+            if (parser.failed() || body.size() + length > limit) break;
+            body.append(data, length);
+        }
+
+        bool done = parser.done();
+        ConnectionPool::shared().release(connection.host, connection.port, connection.fd,
+                                         done && connection.reusable &&
+                                         connection.buffer_start == connection.buffer_end);
+        return done;
+    }
+
+    LOGE("Too many redirects for %s", url.c_str());
+    return false;
+}
+
+// Called between segments. A socket to the mirror being left goes back to
+// the pool if it is clean.
+bool DownloadEngine::chooseMirror(HttpConnection& connection) {
+    int mirror = mirrors_.assign(connection.mirror);
+    if (mirror == connection.mirror) {
+        return mirror >= 0;
+    }
+    ConnectionPool::shared().release(connection.host, connection.port, connection.fd,
+                                     connection.reusable &&
+                                     connection.buffer_start == connection.buffer_end);
+    connection.fd = -1;
+    dropConnection(connection);
+    connection.mirror = mirror;
+    if (mirror < 0) {
+        return false;
+    }
+    const Mirror& source = mirrors_.at(mirror);
+    connection.host = source.host;
+    connection.path = source.path;
+    connection.port = source.port;
+    return true;
+}
+
+bool DownloadEngine::openResponse(HttpConnection& connection, const std::string& request,
+                                  bool request_sent, bool head_request) {
+    if (connection.buffer.empty()) {
+        connection.buffer.resize(BUFFER_SIZE);
+    }
+
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        bool reused = connection.fd >= 0;
+        ConnectionTimings* timings = connection.timings;
+        if (!reused) {
+            ConnectTiming connect_timing;
+            connection.fd = ConnectionPool::shared().acquire(connection.host, connection.port,
+                                                             reused,
+                                                             timings ? &connect_timing : nullptr);
+            if (connection.fd < 0) {
+                return false;
+            }
+            if (timings && !reused) {
+                timings->add(timings->resolve_us, connect_timing.resolve_us);
+                timings->add(timings->connect_us, connect_timing.connect_us);
+                timings->add(timings->connects, 1);
+            }
+            request_sent = false;
+        }
+
+        connection.parser.reset(head_request);
+        bool started = false;
+        int64_t sent_us = timings ? StatsRecorder::nowUs() : 0;
+        if ((request_sent || sendRequest(connection.fd, request)) &&
+            readResponseHead(connection, connection.parser, started)) {
+            connection.reusable = connection.parser.response().keep_alive;
+            if (timings) {
+                timings->recordResponse(StatsRecorder::nowUs() - sent_us);
+            }
+            return true;
+        }
+
+        dropConnection(connection);
+        // A kept-alive socket may have been closed by the server; retry once fresh.
+        if (!reused || started) return false;
+    }
+    return false;
+}
+
+// With mirrors, an answer that rules out one source drops it rather than
+// the download.
+bool DownloadEngine::acceptRangeResponse(const HttpResponse& response,
+                                         const SegmentLease& lease, int mirror) {
+    // A plain 200 carries the whole entity, usable only for a range starting at 0.
+    if (response.status == 200 && lease.offset == 0) return true;
+    if (response.status != 206) {
+        LOGE("Unexpected HTTP status %d for range %lld-%lld", response.status,
+             (long long)lease.offset, (long long)lease.end);
+        http_status_.store(response.status);
+        // Timeouts, throttling and server errors may pass; nothing else will.
+        if (response.status != 408 && response.status != 429 && response.status < 500 &&
+            !mirrors_.drop(mirror)) {
+            fail(FailureReason::HttpStatus);
+        }
+        return false;
+    }
+
+    int64_t first, last, total;
+    const std::string& etag = response.header("etag");
+    bool has_range = parseContentRange(response.header("content-range"), first, last, total);
+    const std::string& expected = mirrors_.at(mirror).etag;
+    if ((has_range && total >= 0 && total != total_bytes_.load()) ||
+        (!etag.empty() && !expected.empty() && etag != expected)) {
+        LOGE("Remote entity changed during download of %s", mirrors_.at(mirror).url.c_str());
+        if (!mirrors_.drop(mirror)) {
+            MetadataCache::shared().invalidate(source_url_);
+            fail(FailureReason::RemoteChanged);
+        }
+        return false;
+    }
+    if (has_range && first != lease.offset) {
+        LOGE("Range response starts at %lld, expected %lld", (long long)first,
+             (long long)lease.offset);
+        return false;
+    }
+    return true;
+}
+
+bool DownloadEngine::downloadSegment(int connection_id, const SegmentLease& lease,
+                                     HttpConnection& connection, bool request_sent) {
+    HttpResponseParser& parser = connection.parser;
+    if (connection.response_open) {
+        connection.response_open = false;
+    } else if (!openResponse(connection, buildRangeRequest(connection.host, connection.path,
+                                                           lease.offset, lease.end),
+                             request_sent, false)) {
+        return false;
+    }
+
+    const HttpResponse& response = parser.response();
+    if (!acceptRangeResponse(response, lease, connection.mirror)) {
+        dropConnection(connection);
+        return false;
+    }
+    trackReceiver(lease.segment_id, connection.fd);
+
+    if (options_.pipeline_requests && connection.reusable && !connection.has_pipelined &&
+        scheduler_.acquire(connection_id, connection.pipelined)) {
+        connection.has_pipelined = true;
+        if (!sendRequest(connection.fd, buildRangeRequest(connection.host, connection.path,
+                                                          connection.pipelined.offset,
+                                                          connection.pipelined.end))) {
+            connection.reusable = false;
+        }
+    }
+
+    bool finished = false;
+    const char* body;
+    size_t body_length;
+
+    while (!should_cancel_.load() && !finished && !parser.done() && !is_paused_.load()) {
+        // Bytes already read along with the headers go through the parser first.
+        if (splice_enabled_.load(std::memory_order_relaxed) && parser.remaining() > 0 &&
+            connection.buffer_start == connection.buffer_end) {
+            if (!spliceBody(connection_id, lease, connection, finished)) break;
+            continue;
+        }
+
+        if (receive(connection) <= 0) break;
+        feedParser(connection, parser, body, body_length);
+        if (parser.failed()) {
+            LOGE("Malformed response body on connection %d", connection_id);
+            break;
+        }
+
+        if (body_length > 0) {
+            if (!consumeBody(connection_id, lease, body, body_length, finished,
+                             connection.timings, connection.arena_buffer)) {
+                break;
+            }
+            connection.body_bytes += body_length;
+        }
+    }
+
+    untrackReceiver(lease.segment_id);
+    if (!finished && scheduler_.completed(lease.segment_id)) {
+        // Lost a hedged race; the socket may have been shut down under us.
+        finished = true;
+        connection.reusable = false;
+    }
+
+    // The tail of this response was stolen by another connection: drain a
+    // small remainder to keep the socket, otherwise give it up.
+    if (!finished || !drainResponse(connection) || !connection.reusable) {
+        dropConnection(connection);
+    }
+
+    if (finished) {
+        LOGD("Segment %d completed on connection %d", lease.segment_id, connection_id);
+    }
+    return finished;
+}
+
+// Threaded receivers register their socket while they read a range, so the
+// copy that wins a hedged race can shut the loser's socket and wake it out
+// of recv(). The event loop backend notices a lost race on its next tick.
+void DownloadEngine::trackReceiver(int segment_id, int fd) {
+    std::lock_guard<std::mutex> lock(receivers_mutex_);
+    receivers_[segment_id] = fd;
+}
+
+void DownloadEngine::untrackReceiver(int segment_id) {
+    std::lock_guard<std::mutex> lock(receivers_mutex_);
+    receivers_.erase(segment_id);
+}
+
+void DownloadEngine::stopTwin(int segment_id) {
+    int twin = scheduler_.twin(segment_id);
+    if (twin < 0) return;
+    std::lock_guard<std::mutex> lock(receivers_mutex_);
+    auto it = receivers_.find(twin);
+    if (it != receivers_.end()) {
+        shutdown(it->second, SHUT_RDWR);
+    }
+}
+
+// Moves one pipe's worth of a fixed-length body into the file. When splice
+// turns out to be unsupported the engine drops to the copying path, which
+// the caller's loop picks up on its next pass.
+bool DownloadEngine::spliceBody(int connection_id, const SegmentLease& lease,
+                                HttpConnection& connection, bool& finished) {
+    SplicePipe& pipe = connection.pipe;
+    if (!pipe.open()) {
+        LOGE("Pipe creation failed, copying bodies instead: %s", strerror(errno));
+        splice_enabled_.store(false);
+        return true;
+    }
+
+    int64_t wait_us;
+    size_t wanted = static_cast<size_t>(std::min<int64_t>(connection.parser.remaining(),
+                                                          pipe.capacity()));
+    size_t admitted = admitRead(wanted, wait_us);
+    ConnectionTimings* timings = connection.timings;
+    throttle(wait_us, timings);
+
+    int64_t started_us = timings ? StatsRecorder::nowUs() : 0;
+    ssize_t received = pipe.fill(connection.fd, admitted);
+    settleRead(admitted, received);
+    if (received < 0 && SplicePipe::unsupported(errno)) {
+        LOGI("Socket splice unsupported, copying bodies instead");
+        splice_enabled_.store(false);
+        return true;
+    }
+    if (timings) {
+        timings->recordRecv(received, StatsRecorder::nowUs() - started_us);
+    }
+    if (received <= 0) {
+        return false;
+    }
+    connection.parser.skipBody(received);
+
+    int64_t offset = 0;
+    int64_t skipped = 0;
+    int64_t granted = scheduler_.take(lease.segment_id, received, offset, finished, skipped);
+    if (finished) {
+        stopTwin(lease.segment_id);
+    }
+    pipe.skip(static_cast<size_t>(skipped), connection.buffer.data(), connection.buffer.size());
+    size_t queued = pipe.pending();
+    started_us = timings ? StatsRecorder::nowUs() : 0;
+    bool written = pipe.drainTo(output_fd_, offset, static_cast<size_t>(granted));
+    if (!written && SplicePipe::unsupported(errno)) {
+        LOGI("Output filesystem refuses splice, copying bodies instead");
+        splice_enabled_.store(false);
+        int64_t placed = static_cast<int64_t>(queued - pipe.pending());
+        written = pipe.copyTo(output_fd_, offset + placed, granted - placed,
+                              connection.buffer.data(), connection.buffer.size());
+    }
+    if (timings) {
+        timings->recordWrite(granted, StatsRecorder::nowUs() - started_us);
+    }
+    if (!written) {
+        LOGE("Write failed on connection %d: %s", connection_id, strerror(errno));
+        fail(FailureReason::Storage);
+        return false;
+    }
+    // The tail past a stolen split belongs to another connection.
+    pipe.discard(connection.buffer.data(), connection.buffer.size());
+
+    journal_.markWritten(offset, granted);
+    journal_.flushIfDue(output_fd_);
+    recordBytes(connection_id, granted);
+    connection.body_bytes += received;
+    return true;
+}
+
+bool DownloadEngine::streamBody(int connection_id, HttpConnection& connection) {
+    HttpResponseParser& parser = connection.parser;
+    if (connection.response_open) {
+        connection.response_open = false;
+    } else if (!openResponse(connection, buildGetRequest(connection.host, connection.path,
+                                                         options_.decompress),
+                             false, false)) {
+        return false;
+    }
+
+    const HttpResponse& response = parser.response();
+    if (response.status != 200) {
+        LOGE("Unexpected HTTP status %d", response.status);
+        dropConnection(connection);
+        return false;
+    }
+
+    const std::string& encoding = response.header("content-encoding");
+    bool decoding = options_.decompress && !encoding.empty() && lowercase(encoding) != "identity";
+    if (decoding && !inflater_.begin(encoding)) {
+        LOGE("Unsupported Content-Encoding %s", encoding.c_str());
+        dropConnection(connection);
+        return false;
+    }
+    // Progress counts wire bytes, so the total is the encoded length.
+    if (response.content_length >= 0) {
+        total_bytes_.store(response.content_length);
+    }
+
+    int64_t offset = 0;
+    const char* body;
+    size_t body_length;
+    InflateSink sink = [this, connection_id, &connection, &offset](const char* data,
+                                                                   size_t length) {
+        if (!timedWrite(output_fd_, data, length, offset, connection.timings)) {
+            LOGE("Write failed on connection %d: %s", connection_id, strerror(errno));
+            fail(FailureReason::Storage);
+            return false;
+        }
+        if (!verifyWritten(data, length, offset)) {
+            return false;
+        }
+        offset += length;
+        decoded_bytes_.store(offset, std::memory_order_relaxed);
+        return true;
+    };
+
+    while (!should_cancel_.load() && !parser.done()) {
+        // Without ranges the body cannot be re-requested, so the stream
+        // keeps its socket and lets TCP flow control hold the server.
+        if (is_paused_.load()) {
+            waitWhilePaused();
+            continue;
+        }
+
+        ssize_t available = receive(connection);
+        if (available <= 0) {
+            if (available == 0) parser.finishOnClose();
+            break;
+        }
+        feedParser(connection, parser, body, body_length);
+        if (parser.failed()) {
+            LOGE("Malformed response body on connection %d", connection_id);
+            break;
+        }
+
+        if (body_length > 0) {
+            recordBytes(connection_id, body_length);
+            if (decoding ? !inflater_.decode(body, body_length, sink) : !sink(body, body_length)) {
+                break;
+            }
+        }
+    }
+
+    stream_complete_ = parser.done() && (!decoding || inflater_.finished());
+    if (!stream_complete_ || !connection.reusable) {
+        dropConnection(connection);
+    }
+    return stream_complete_;
+}
+
+// Drives one connection of an EventLoop-backed download through
+// connect -> send -> headers -> body, then pulls the next segment.
+class AsyncConnection : public EventHandler {
+public:
+    AsyncConnection(DownloadEngine* engine, int connection_id, int loop)
+        : engine_(engine)
+        , connection_id_(connection_id)
+        , loop_(loop)
+        , fd_(-1)
+        , state_(State::Connecting)
+        , lease_{-1, 0, 0}
+        , sent_(0)
+        , last_activity_ms_(0)
+        , reused_(false)
+        , reusable_(false)
+        , responded_(false)
+        , throttled_(false)
+        , address_(0)
+        , reserved_(0)
+        , timings_(engine->stats_.open(connection_id))
+        , connect_started_us_(0)
+        , request_sent_us_(0)
+        , last_read_us_(0)
+        , retired_(false)
+        , attempts_(0)
+        , backing_off_(false)
+        , mirror_(-1)
+        , segment_bytes_(0)
+        , segment_started_ms_(0) {
+        engine_->active_connections_.fetch_add(1);
+    }
+
+    void start() {
+        if (!beginSegment(false)) {
+            finish();
+        }
+    }
+
+    void onEvent(uint32_t events) override {
+        // Stale readiness for the socket that just failed.
+        if (backing_off_) {
+            return;
+        }
+        if (engine_->is_paused_.load()) {
+            suspend();
+            return;
+        }
+        last_activity_ms_ = nowMs();
+
+        if (state_ == State::Connecting) {
+            int error = 0;
+            socklen_t length = sizeof(error);
+            if ((events & (EPOLLERR | EPOLLHUP)) ||
+                getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+                retryConnect();
+                return;
+            }
+            if (timings_ && !reused_ && connect_started_us_ > 0) {
+                timings_->add(timings_->connect_us, StatsRecorder::nowUs() - connect_started_us_);
+                timings_->add(timings_->connects, 1);
+                connect_started_us_ = 0;
+            }
+            if (!flushRequest()) {
+                endSegment(false);
+                return;
+            }
+            if (sent_ == request_.size()) {
+                if (timings_) request_sent_us_ = last_read_us_ = StatsRecorder::nowUs();
+                state_ = State::Headers;
+                EventLoop::shared().modify(loop_, fd_, EPOLLIN, this);
+            }
+            return;
+        }
+
+        char* buffer = EventLoop::shared().scratch(loop_);
+        size_t wanted = EventLoop::SCRATCH_SIZE;
+        int64_t left = parser_.remaining();
+        if (left > 0) {
+            wanted = static_cast<size_t>(std::min<int64_t>(left, wanted));
+        }
+        if (reserved_ == 0) {
+            int64_t wait_us;
+            reserved_ = engine_->admitRead(wanted, wait_us);
+            // Over budget: stop polling the socket and come back when the
+            // reservation is due instead of spinning on readiness.
+            if (wait_us >= 1000) {
+                if (timings_) timings_->add(timings_->throttle_us, wait_us);
+                EventLoop::shared().modify(loop_, fd_, 0, this);
+                EventLoop::shared().wakeAt(loop_, nowMs() + wait_us / 1000, this);
+                throttled_ = true;
+                return;
+            }
+        }
+        wanted = std::min(wanted, reserved_);
+        ssize_t received = recv(fd_, buffer, wanted, 0);
+        engine_->settleRead(reserved_, received);
+        reserved_ = 0;
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            return;
+        }
+        if (timings_) {
+            // Waiting happens in epoll here, so the wait is the gap since the last read.
+            int64_t now_us = StatsRecorder::nowUs();
+            timings_->recordRecv(received, now_us - last_read_us_);
+            last_read_us_ = now_us;
+        }
+        if (received <= 0) {
+            // A kept-alive socket may have been closed by the server while idle.
+            if (!responded_ && reused_) {
+                closeSocket();
+                if (!beginSegment(true)) finish();
+                return;
+            }
+            endSegment(false);
+            return;
+        }
+
+        responded_ = true;
+        processInput(buffer, static_cast<size_t>(received));
+    }
+
+    void onTick(int64_t now_ms) override {
+        if (engine_->should_cancel_.load()) {
+            endSegment(false);
+            return;
+        }
+        if (engine_->is_paused_.load()) {
+            suspend();
+            return;
+        }
+        if (backing_off_) {
+            return;
+        }
+        if (lease_.segment_id >= 0 && engine_->scheduler_.completed(lease_.segment_id)) {
+            // The other copy of a hedged range got there first.
+            reusable_ = false;
+            endSegment(true);
+            return;
+        }
+        if (throttled_) {
+            last_activity_ms_ = now_ms;
+            return;
+        }
+        if (state_ == State::Connecting && !reused_ &&
+            address_ + 1 < engine_->mirrors_.at(mirror_).addrs.size() &&
+            now_ms - last_activity_ms_ > ADDRESS_TIMEOUT_MS) {
+            retryConnect();
+            return;
+        }
+        if (now_ms - last_activity_ms_ > CONNECT_TIMEOUT * 1000) {
+            LOGE("Connection %d timed out", connection_id_);
+            endSegment(false);
+        }
+    }
+
+    void onTimer(int64_t now_ms) override {
+        throttled_ = false;
+        last_activity_ms_ = now_ms;
+        if (engine_->is_paused_.load()) {
+            suspend();
+            return;
+        }
+        if (backing_off_) {
+            detach();
+            if (!beginSegment(false)) finish();
+            return;
+        }
+        EventLoop::shared().modify(loop_, fd_, EPOLLIN, this);
+    }
+
+    // Posted by the engine on resume or cancel.
+    void wake() {
+        engine_->active_connections_.fetch_add(1);
+        if (!beginSegment(false)) {
+            finish();
+        }
+    }
+
+private:
+    enum class State { Connecting, Headers, Body };
+
+    static int64_t nowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    bool beginSegment(bool fresh) {
+        if (!fresh && !engine_->should_cancel_.load() && engine_->retireConnection()) {
+            retired_ = true;
+            return false;
+        }
+        if (!fresh && (engine_->should_cancel_.load() || !chooseMirror() ||
+                       !engine_->scheduler_.acquire(connection_id_, lease_))) {
+            return false;
+        }
+        if (!fresh) {
+            segment_bytes_ = 0;
+            segment_started_ms_ = nowMs();
+        }
+
+        const Mirror& source = engine_->mirrors_.at(mirror_);
+        if (fd_ >= 0) {
+            reused_ = true;
+            EventLoop::shared().modify(loop_, fd_, EPOLLOUT, this);
+        } else if (!fresh && (fd_ = ConnectionPool::shared().acquireIdle(
+                                  source.host, source.port)) >= 0) {
+            reused_ = true;
+            fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) | O_NONBLOCK);
+            if (!EventLoop::shared().watch(loop_, fd_, EPOLLOUT, this)) {
+                return abandonSegment();
+            }
+        } else {
+            reused_ = false;
+            address_ = 0;
+            if (!connectAddress()) {
+                return abandonSegment();
+            }
+        }
+
+        request_ = buildRangeRequest(source.host, source.path, lease_.offset, lease_.end);
+        sent_ = 0;
+        parser_.reset();
+        reusable_ = false;
+        responded_ = false;
+        state_ = State::Connecting;
+        last_activity_ms_ = nowMs();
+        return true;
+    }
+
+    bool connectAddress() {
+        const ResolvedAddress& address = engine_->mirrors_.at(mirror_).addrs[address_];
+        if (timings_ && connect_started_us_ == 0) connect_started_us_ = StatsRecorder::nowUs();
+        fd_ = socket(address.addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd_ >= 0) {
+            int flag = 1;
+            setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+        }
+        return fd_ >= 0 &&
+            (connect(fd_, reinterpret_cast<const struct sockaddr*>(&address.addr),
+                     address.length) == 0 || errno == EINPROGRESS) &&
+            EventLoop::shared().watch(loop_, fd_, EPOLLOUT, this);
+    }
+
+    // Falls through the resolved addresses, which alternate IPv6 and IPv4.
+    void retryConnect() {
+        closeSocket();
+        while (++address_ < engine_->mirrors_.at(mirror_).addrs.size()) {
+            if (connectAddress()) {
+                last_activity_ms_ = nowMs();
+                return;
+            }
+            if (fd_ >= 0) close(fd_);
+            fd_ = -1;
+        }
+        LOGE("Async connect failed on connection %d", connection_id_);
+        endSegment(false);
+    }
+
+    // Between segments only; a kept-alive socket to the mirror being left
+    // goes back to the pool.
+    bool chooseMirror() {
+        int mirror = engine_->mirrors_.assign(mirror_);
+        if (mirror != mirror_ && fd_ >= 0) {
+            EventLoop::shared().unwatch(loop_, fd_, this);
+            const Mirror& previous = engine_->mirrors_.at(mirror_);
+            ConnectionPool::shared().release(previous.host, previous.port, fd_, true);
+            fd_ = -1;
+        }
+        mirror_ = mirror;
+        return mirror_ >= 0;
+    }
+
+    bool abandonSegment() {
+        LOGE("Failed to start async connection %d", connection_id_);
+        if (fd_ >= 0) close(fd_);
+        fd_ = -1;
+        releaseLease();
+        return false;
+    }
+
+    bool flushRequest() {
+        while (sent_ < request_.size()) {
+            ssize_t sent = send(fd_, request_.data() + sent_, request_.size() - sent_, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+                if (errno == EINTR) continue;
+                return false;
+            }
+            sent_ += sent;
+        }
+        return true;
+    }
+
+    // Body spans point straight into the loop's scratch buffer.
+    void processInput(const char* data, size_t length) {
+        while (length > 0) {
+            const char* body;
+            size_t body_length;
+            size_t used = parser_.feed(data, length, body, body_length);
+            data += used;
+            length -= used;
+
+            if (parser_.failed()) {
+                LOGE("Malformed HTTP response on connection %d", connection_id_);
+                endSegment(false);
+                return;
+            }
+            if (state_ == State::Headers) {
+                if (!parser_.headersComplete()) continue;
+                state_ = State::Body;
+                if (timings_) {
+                    timings_->recordResponse(StatsRecorder::nowUs() - request_sent_us_);
+                }
+                if (!engine_->acceptRangeResponse(parser_.response(), lease_, mirror_)) {
+                    endSegment(false);
+                    return;
+                }
+                reusable_ = parser_.response().keep_alive;
+            }
+
+            if (body_length > 0) {
+                bool finished = false;
+                if (!engine_->consumeBody(connection_id_, lease_, body, body_length,
+                                          finished, timings_)) {
+                    endSegment(false);
+                    return;
+                }
+                attempts_ = 0;
+                segment_bytes_ += static_cast<int64_t>(body_length);
+                if (finished) {
+                    if (length > 0) reusable_ = false;
+                    endSegment(true);
+                    return;
+                }
+            }
+
+            if (parser_.done()) {
+                endSegment(false);
+                return;
+            }
+        }
+    }
+
+    void closeSocket() {
+        engine_->settleRead(reserved_, 0);
+        reserved_ = 0;
+        throttled_ = false;
+        if (fd_ >= 0) {
+            EventLoop::shared().unwatch(loop_, fd_, this);
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    // Pausing gives back the socket and the segment, which keeps its
+    // progress; wake() starts over with a Range from start + downloaded.
+    void suspend() {
+        detach();
+        closeSocket();
+        releaseLease();
+        engine_->active_connections_.fetch_sub(1);
+        if (!engine_->parkConnection(this, loop_)) {
+            wake();
+        }
+    }
+
+    void endSegment(bool ok) {
+        // Only a fully consumed response leaves the socket ready for another request.
+        if (!ok || !reusable_ || !parser_.done()) {
+            closeSocket();
+        }
+        MirrorSet& mirrors = engine_->mirrors_;
+        int64_t elapsed_ms = nowMs() - segment_started_ms_;
+        if (!ok) {
+            releaseLease();
+            if (engine_->should_cancel_.load()) {
+                finish();
+                return;
+            }
+            engine_->tuner_.onConnectionError();
+            if (segment_bytes_ > 0) {
+                mirrors.recordSuccess(mirror_, segment_bytes_, elapsed_ms);
+            } else if (mirrors.recordFailure(mirror_)) {
+                // The rest of the segment goes straight to another mirror.
+                attempts_ = 0;
+                if (!beginSegment(false)) finish();
+                return;
+            }
+            if (attempts_ < MAX_SEGMENT_RETRIES) {
+                retryLater();
+                return;
+            }
+            LOGE("Connection %d giving up after %d retries", connection_id_, attempts_);
+            int none = static_cast<int>(FailureReason::None);
+            engine_->failure_reason_.compare_exchange_strong(
+                none, static_cast<int>(FailureReason::Network));
+            finish();
+            return;
+        }
+        mirrors.recordSuccess(mirror_, segment_bytes_, elapsed_ms);
+        LOGD("Segment %d completed on connection %d", lease_.segment_id, connection_id_);
+        if (!beginSegment(false)) {
+            finish();
+        }
+    }
+
+    void releaseLease() {
+        if (lease_.segment_id >= 0) {
+            engine_->scheduler_.release(lease_.segment_id);
+            lease_.segment_id = -1;
+        }
+    }
+
+    // With no socket to watch, attaching keeps ticks and the timer coming.
+    void retryLater() {
+        EventLoop::shared().attach(loop_, this);
+        backing_off_ = true;
+        EventLoop::shared().wakeAt(loop_, nowMs() + engine_->nextRetryDelay(attempts_++), this);
+    }
+
+    void detach() {
+        if (backing_off_) {
+            EventLoop::shared().unwatch(loop_, -1, this);
+            backing_off_ = false;
+        }
+    }
+
+    void finish() {
+        detach();
+        if (fd_ >= 0 && reusable_ && parser_.done()) {
+            EventLoop::shared().unwatch(loop_, fd_, this);
+            const Mirror& source = engine_->mirrors_.at(mirror_);
+            ConnectionPool::shared().release(source.host, source.port, fd_, true);
+            fd_ = -1;
+        }
+        closeSocket();
+        engine_->mirrors_.leave(mirror_);
+        engine_->active_connections_.fetch_sub(1);
+        // A retired connection already gave up its place in the live count.
+        if (!retired_) engine_->onAsyncConnectionDone();
+        EventLoop::shared().post(loop_, [this]() { delete this; });
+    }
+
+    DownloadEngine* engine_;
+    int connection_id_;
+    int loop_;
+    int fd_;
+    State state_;
+    SegmentLease lease_;
+    std::string request_;
+    size_t sent_;
+    HttpResponseParser parser_;
+    int64_t last_activity_ms_;
+    bool reused_;
+    bool reusable_;
+    bool responded_;
+    bool throttled_;
+    size_t address_;
+    size_t reserved_;
+    ConnectionTimings* timings_;
+    int64_t connect_started_us_;
+    int64_t request_sent_us_;
+    int64_t last_read_us_;
+    bool retired_;
+    int attempts_;
+    bool backing_off_;
+    int mirror_;
+    int64_t segment_bytes_;
+    int64_t segment_started_ms_;
+};
+
+bool DownloadEngine::launchAsync() {
+    int64_t resolve_started_us = StatsRecorder::nowUs();
+    if (!mirrors_.resolveAll()) {
+        return false;
+    }
+    stats_.recordResolve(StatsRecorder::nowUs() - resolve_started_us);
+
+    {
+        std::lock_guard<std::mutex> lock(async_mutex_);
+        async_running_ = true;
+    }
+    live_connections_.store(num_connections_);
+    next_connection_id_.store(num_connections_);
+
+    // Finishing can read the whole file back and sync it, which would stall
+    // every download sharing the loop, so it runs here instead.
+    supervisor_ = std::thread([this]() {
+        {
+            std::unique_lock<std::mutex> lock(async_mutex_);
+            async_cv_.wait(lock, [this] { return live_connections_.load() == 0; });
+        }
+        finishDownload();
+        {
+            std::lock_guard<std::mutex> lock(async_mutex_);
+            async_running_ = false;
+        }
+        async_cv_.notify_all();
+    });
+
+    EventLoop& loop = EventLoop::shared();
+    for (int i = 0; i < num_connections_; ++i) {
+        int index = loop.pick();
+        auto* connection = new AsyncConnection(this, i, index);
+        loop.post(index, [connection]() { connection->start(); });
+    }
+
+    LOGI("Started %d event-driven connections", num_connections_);
+    return true;
+}
+
+// Adds one connection to a running adaptive download. The live count only
+// grows while it is above zero, so nothing starts after the last connection
+// has begun tearing the download down.
+bool DownloadEngine::launchConnection() {
+    int live = live_connections_.load();
+    do {
+        if (live == 0) return false;
+    } while (!live_connections_.compare_exchange_weak(live, live + 1));
+
+    int connection_id = next_connection_id_.fetch_add(1);
+    if (options_.io_backend == IoBackend::EventLoop) {
+        EventLoop& loop = EventLoop::shared();
+        int index = loop.pick();
+        auto* connection = new AsyncConnection(this, connection_id, index);
+        loop.post(index, [connection]() { connection->start(); });
+    } else {
+        std::lock_guard<std::mutex> lock(workers_mutex_);
+        worker_threads_.push_back(
+            std::make_unique<std::thread>(&DownloadEngine::runConnection, this, connection_id));
+    }
+    return true;
+}
+
+// Called at segment boundaries. Never drops the last connection, since
+// target() is at least one, so finishing stays with whoever runs dry.
+bool DownloadEngine::retireConnection() {
+    if (!adaptive_) return false;
+    int target = tuner_.target();
+    int live = live_connections_.load();
+    while (live > target) {
+        if (live_connections_.compare_exchange_weak(live, live - 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Runs on the reporter thread after each tuner sample.
+void DownloadEngine::adjustConnections() {
+    int target = tuner_.target();
+    while (live_connections_.load() < target && !is_paused_.load() && hasPendingWork()) {
+        if (!launchConnection()) break;
+    }
+}
+
+void DownloadEngine::onAsyncConnectionDone() {
+    if (live_connections_.fetch_sub(1) != 1) return;
+
+    // Taken so the supervisor cannot miss the wakeup between its check and wait.
+    {
+        std::lock_guard<std::mutex> lock(async_mutex_);
+    }
+    async_cv_.notify_all();
+}
+
+bool DownloadEngine::startDownload(const std::string& url, 
+                                   const std::string& output_path,
+                                   int num_connections,
+                                   ProgressCallback progress_callback) {
+    DownloadOptions options;
+    options.num_connections = num_connections;
+    return startDownload(url, output_path, options, progress_callback);
+}
+
+bool DownloadEngine::startDownload(const std::string& url,
+                                   const std::string& output_path,
+                                   const DownloadOptions& options,
+                                   ProgressCallback progress_callback) {
+    if (is_downloading_.load()) {
+        LOGE("Download already in progress");
+        return false;
+    }
+
+    options_ = options;
+    rate_limiter_.setRate(options.rate_limit);
+    if (!prepareDownload(url, output_path, options.num_connections, progress_callback)) {
+        return false;
+    }
+    if (outcome_.load() == static_cast<int>(DownloadOutcome::Unchanged)) {
+        return true;
+    }
+    return launchWorkers();
+}
+
+bool DownloadEngine::prepareDownload(const std::string& url,
+                                     const std::string& output_path,
+                                     int num_connections,
+                                     ProgressCallback progress_callback) {
+    if (is_downloading_.load()) {
+        LOGE("Download already in progress");
+        return false;
+    }
+
+    resetDownload(url, num_connections, progress_callback);
+
+    // Whether the local copy is current hangs on the validators, so they
+    // must be fresh.
+    if (!options_.local_etag.empty() || !options_.local_last_modified.empty()) {
+        MetadataCache::shared().invalidate(url);
+    }
+    if (!initializeDownload(url)) {
+        return false;
+    }
+
+    if (localCopyCurrent(output_path)) {
+        LOGI("%s is unchanged on the server, keeping the local copy", output_path.c_str());
+        dropConnection(probe_connection_);
+        beginProgress(total_bytes_.load());
+        ProgressReporter::shared().remove(this);
+        ProgressBoard::shared().publish(progress_slot_, getProgress(), false);
+        reused_bytes_.store(total_bytes_.load());
+        outcome_.store(static_cast<int>(DownloadOutcome::Unchanged));
+        return true;
+    }
+
+    bool delta = !options_.delta_manifest_url.empty() && supports_ranges_ && !streaming_ &&
+                 total_bytes_.load() > 0 && prepareDelta(output_path);
+    if (!delta) {
+        if (!prepareOutputFile(output_path, total_bytes_.load(), false)) {
+            dropConnection(probe_connection_);
+            return false;
+        }
+        if (supports_ranges_ && !streaming_) {
+            journal_.create(output_path, url, remote_etag_, remote_last_modified_,
+                            total_bytes_.load());
+        }
+    }
+
+    verifier_.reset(options_.integrity, total_bytes_.load());
+    beginProgress(reused_bytes_.load());
+    is_downloading_.store(true);
+    return true;
+}
+
+bool DownloadEngine::localCopyCurrent(const std::string& output_path) const {
+    bool etag_matches = !options_.local_etag.empty() && options_.local_etag == remote_etag_;
+    bool date_matches = !options_.local_last_modified.empty() &&
+                        options_.local_last_modified == remote_last_modified_;
+    if (streaming_ || (!etag_matches && !date_matches)) return false;
+
+    struct stat st;
+    return stat(output_path.c_str(), &st) == 0 && st.st_size == total_bytes_.load();
+}
+
+// Rebuilds output_path from its older self: blocks the manifest finds in it
+// are copied into a fresh file and only the rest is scheduled, much as a
+// journal resume would. Returns false, leaving the old file in place, when
+// there is nothing to reuse.
+bool DownloadEngine::prepareDelta(const std::string& output_path) {
+    int64_t total = total_bytes_.load();
+    std::string manifest;
+    DeltaSync delta;
+    if (!fetchBody(options_.delta_manifest_url, manifest, DeltaSync::MAX_MANIFEST_SIZE) ||
+        !delta.parseManifest(manifest.data(), manifest.size())) {
+        LOGE("No usable manifest at %s, downloading in full", options_.delta_manifest_url.c_str());
+        return false;
+    }
+    if (delta.length() != total) {
+        LOGE("Manifest describes %lld bytes but the file has %lld, downloading in full",
+             (long long)delta.length(), (long long)total);
+        return false;
+    }
+    if (!delta.matchSeed(output_path) || delta.reusedBytes() == 0) {
+        return false;
+    }
+
+    // Kept until the reused blocks are durable in the new file.
+    std::string seed_path = output_path + ".orion-seed";
+    if (rename(output_path.c_str(), seed_path.c_str()) != 0) {
+        LOGE("Cannot set aside %s: %s", output_path.c_str(), strerror(errno));
+        return false;
+    }
+    bool ok = prepareOutputFile(output_path, total, false);
+    for (const DeltaCopy& copy : delta.copies()) {
+        if (!ok) break;
+        ok = writeAt(output_fd_, reinterpret_cast<const char*>(delta.seed()) + copy.source,
+                     static_cast<size_t>(copy.length), copy.target);
+    }
+    if (!ok) {
+        LOGE("Cannot rebuild %s from the local copy: %s", output_path.c_str(), strerror(errno));
+        closeOutputFile();
+        rename(seed_path.c_str(), output_path.c_str());
+        return false;
+    }
+
+    journal_.create(output_path, source_url_, remote_etag_, remote_last_modified_, total);
+    for (const DeltaCopy& copy : delta.copies()) {
+        journal_.markWritten(copy.target, copy.length);
+    }
+    journal_.flush(output_fd_);
+    unlink(seed_path.c_str());
+    delta.release();
+
+    // The probe's body is the head of the file, which may now be local.
+    dropConnection(probe_connection_);
+    scheduler_.resetMissing(total, num_connections_, delta.missing());
+    scheduler_.setEndgame(options_.endgame_bytes);
+    if (options_.integrity.algorithm == HashAlgorithm::None && !delta.fileDigest().empty()) {
+        options_.integrity.algorithm = HashAlgorithm::Sha256;
+        options_.integrity.expected_digest = delta.fileDigest();
+    }
+    reused_bytes_.store(delta.reusedBytes());
+    LOGI("Delta update of %s: %lld bytes reused, %lld to fetch in %zu ranges",
+         output_path.c_str(), (long long)delta.reusedBytes(),
+         (long long)(total - delta.reusedBytes()), delta.missing().size());
+    return true;
+}
+
+bool DownloadEngine::resumeFromJournal(const std::string& output_path,
+                                       int num_connections,
+                                       ProgressCallback progress_callback) {
+    DownloadOptions options;
+    options.num_connections = num_connections;
+    return resumeFromJournal(output_path, options, progress_callback);
+}
+
+bool DownloadEngine::resumeFromJournal(const std::string& output_path,
+                                       const DownloadOptions& options,
+                                       ProgressCallback progress_callback) {
+    if (is_downloading_.load()) {
+        LOGE("Download already in progress");
+        return false;
+    }
+
+    JournalState state;
+    if (!ResumeJournal::load(output_path, state)) {
+        LOGE("No usable journal for %s", output_path.c_str());
+        return false;
+    }
+
+    // Validators must be fresh here, so bypass the cache and refresh it.
+    ResourceInfo info;
+    if (!probeResource(state.url, info, 1, nullptr)) {
+        return false;
+    }
+    MetadataCache::shared().store(state.url, info);
+
+    int64_t content_length = info.content_length;
+    bool supports_ranges = info.supports_ranges;
+    const std::string& etag = info.etag;
+    const std::string& last_modified = info.last_modified;
+
+    bool unchanged = supports_ranges && content_length == state.total_size &&
+        (!state.etag.empty() ? etag == state.etag
+                             : !state.last_modified.empty() && last_modified == state.last_modified);
+    if (!unchanged) {
+        LOGI("Remote file changed since journal was written, restarting");
+        return startDownload(state.url, output_path, options, progress_callback);
+    }
+
+    options_ = options;
+    rate_limiter_.setRate(options.rate_limit);
+    resetDownload(state.url, options.num_connections, progress_callback);
+
+    if (!prepareOutputFile(output_path, content_length, true) ||
+        !journal_.open(output_path, content_length)) {
+        closeOutputFile();
+        return startDownload(state.url, output_path, options, progress_callback);
+    }
+
+    int64_t missing = 0;
+    for (const auto& range : state.missing_ranges) {
+        missing += range.second - range.first + 1;
+    }
+
+    remote_etag_ = etag;
+    remote_last_modified_ = last_modified;
+    supports_ranges_ = true;
+    total_bytes_.store(content_length);
+    scheduler_.resetMissing(content_length, num_connections_, state.missing_ranges);
+
+    LOGI("Resuming %s: %lld of %lld bytes missing in %zu ranges", state.url.c_str(),
+         (long long)missing, (long long)content_length, state.missing_ranges.size());
+
+    source_url_ = state.url;
+    url_ = info.final_url;
+    mirrors_.clear();
+    addMirror(url_, etag);
+    if (!options_.mirrors.empty()) {
+        probeMirrors(info);
+    }
+    scheduler_.setEndgame(options_.endgame_bytes);
+    // Bytes from the earlier session are behind the digest frontier, so
+    // finish() reads them back.
+    verifier_.reset(options_.integrity, content_length);
+    beginProgress(content_length - missing);
+    is_downloading_.store(true);
+    return launchWorkers();
+}
+
+// Clears what one download leaves behind on the engine, so a handle can go
+// on to another download or a resume. Runs before the new one is probed.
+void DownloadEngine::resetDownload(const std::string& url, int num_connections,
+                                   ProgressCallback progress_callback) {
+    chooseConnections(url, num_connections);
+    parks_workers_ = false;
+    progress_callback_ = progress_callback;
+    should_cancel_.store(false);
+    is_paused_.store(false);
+    streaming_ = false;
+    stream_complete_ = false;
+    stats_.reset(options_.collect_stats);
+    reused_bytes_.store(0);
+}
+
+// AUTO_CONNECTIONS starts from the count that served this host best last
+// time; initializeDownload turns it off again for single-stream bodies.
+void DownloadEngine::chooseConnections(const std::string& url, int requested) {
+    adaptive_ = requested == AUTO_CONNECTIONS;
+    if (adaptive_) {
+        tuner_.reset(hostKey(url));
+        num_connections_ = tuner_.target();
+    } else {
+        num_connections_ = std::min(std::max(requested, 1), 16);
+    }
+}
+
+bool DownloadEngine::launchWorkers() {
+    if (supervisor_.joinable()) {
+        supervisor_.join();
+    }
+    parks_workers_ = true;
+
+    splice_enabled_.store(options_.io_backend == IoBackend::Splice && !verifier_.active());
+    if (options_.io_backend == IoBackend::Splice && verifier_.active()) {
+        LOGI("Integrity hashing reads every byte, copying bodies instead of splicing");
+    }
+
+    // Bodies of unknown length are a single sequential stream; keep those on a thread.
+    if (options_.io_backend == IoBackend::EventLoop && !streaming_) {
+        if (launchAsync()) {
+            return true;
+        }
+        finishDownload();
+        return false;
+    }
+    if (options_.write_behind_buffers > 0 && !streaming_ &&
+        !write_behind_.start(output_fd_, static_cast<size_t>(options_.write_behind_buffers),
+                             options_.write_sync_bytes,
+                             [this](const char* data, int64_t length, int64_t offset) {
+                                 onWritten(data, length, offset);
+                             })) {
+        LOGE("Write-behind unavailable, writing on the receiving threads");
+    }
+    worker_threads_.clear();
+    live_connections_.store(num_connections_);
+    next_connection_id_.store(num_connections_);
+
+    {
+        std::lock_guard<std::mutex> lock(workers_mutex_);
+        for (int i = 0; i < num_connections_; ++i) {
+            worker_threads_.push_back(
+                std::make_unique<std::thread>(
+                    &DownloadEngine::runConnection, this, i
+                )
+            );
+        }
+    }
+
+    // Adaptive downloads append threads while these run, so keep joining
+    // until the list is drained and no launch is still in flight.
+    supervisor_ = std::thread([this]() {
+        for (size_t i = 0;;) {
+            std::thread* thread = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(workers_mutex_);
+                if (i < worker_threads_.size()) thread = worker_threads_[i].get();
+            }
+            if (thread) {
+                if (thread->joinable()) thread->join();
+                i++;
+            } else if (!adaptive_ || live_connections_.load() == 0) {
+                break;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        finishDownload();
+    });
+    return true;
+}
+
+bool DownloadEngine::hasPendingWork() const {
+    return !should_cancel_.load() && scheduler_.hasAvailableWork();
+}
+
+bool DownloadEngine::finishDownload() {
+    if (probe_connection_.fd >= 0) {
+        dropConnection(probe_connection_);
+    }
+    // Queued spans land before anything below looks at the file.
+    bool written = write_behind_.stop();
+
+    bool complete = (streaming_ ? stream_complete_ : scheduler_.isComplete()) && written;
+    if (complete && streaming_) {
+        total_bytes_.store(downloadedBytes());
+    }
+    int64_t file_size = streaming_ ? decoded_bytes_.load() : total_bytes_.load();
+    bool verified = !complete || verifier_.finish(output_fd_, file_size);
+    if (streaming_) {
+        complete = complete && verified;
+    } else if (complete) {
+        journal_.remove();
+        complete = verified;
+    } else {
+        journal_.flush(output_fd_);
+        journal_.close();
+    }
+    closeOutputFile();
+    // Delivers the final progress callback before the engine goes idle.
+    ProgressReporter::shared().remove(this);
+    ProgressBoard::shared().publish(progress_slot_, getProgress(), false);
+    if (adaptive_) {
+        tuner_.finish();
+    }
+    mirrors_.logSummary();
+
+    if (!written) {
+        fail(FailureReason::Storage);
+    } else if (!verified) {
+        fail(FailureReason::Integrity);
+    }
+    DownloadOutcome outcome = DownloadOutcome::Completed;
+    if (complete) {
+        failure_reason_.store(static_cast<int>(FailureReason::None));
+    } else if (failure_reason_.load() != static_cast<int>(FailureReason::None)) {
+        outcome = DownloadOutcome::Failed;
+    } else if (should_cancel_.load()) {
+        outcome = DownloadOutcome::Cancelled;
+    } else {
+        outcome = DownloadOutcome::Failed;
+        failure_reason_.store(static_cast<int>(FailureReason::Network));
+    }
+    outcome_.store(static_cast<int>(outcome));
+
+    is_downloading_.store(false);
+    if (complete) {
+        LOGI("Download completed");
+    } else {
+        LOGE("Download stopped with %lld bytes missing",
+             (long long)scheduler_.remainingBytes());
+    }
+    return complete;
+}
+
+void DownloadEngine::prefetchHost(const std::string& url) {
+    std::string host, path;
+    int port;
+    bool is_https;
+    if (parseUrl(url, host, path, port, is_https)) {
+        DnsResolver::shared().prefetch(host);
+    }
+}
+
+std::string DownloadEngine::hostKey(const std::string& url) {
+    std::string host, path;
+    int port;
+    bool is_https;
+    if (!parseUrl(url, host, path, port, is_https)) {
+        return "";
+    }
+    return host + ":" + std::to_string(port);
+}
+
+void DownloadEngine::pauseDownload() {
+    {
+        std::lock_guard<std::mutex> lock(pause_mutex_);
+        is_paused_.store(true);
+    }
+    pause_cv_.notify_all();
+    LOGD("Download paused");
+}
+
+void DownloadEngine::resumeDownload() {
+    {
+        std::lock_guard<std::mutex> lock(pause_mutex_);
+        is_paused_.store(false);
+    }
+    wakeParked();
+    LOGD("Download resumed");
+}
+
+void DownloadEngine::waitWhilePaused() {
+    active_connections_.fetch_sub(1);
+    {
+        std::unique_lock<std::mutex> lock(pause_mutex_);
+        pause_cv_.wait(lock, [this] { return !is_paused_.load() || should_cancel_.load(); });
+    }
+    active_connections_.fetch_add(1);
+}
+
+// Returns false when the pause already ended, so the caller carries on.
+bool DownloadEngine::parkConnection(AsyncConnection* connection, int loop) {
+    std::lock_guard<std::mutex> lock(pause_mutex_);
+    if (!is_paused_.load() || should_cancel_.load()) return false;
+    parked_.push_back({connection, loop});
+    return true;
+}
+
+void DownloadEngine::wakeParked() {
+    std::vector<ParkedConnection> parked;
+    {
+        std::lock_guard<std::mutex> lock(pause_mutex_);
+        parked.swap(parked_);
+    }
+    pause_cv_.notify_all();
+    for (const ParkedConnection& entry : parked) {
+        AsyncConnection* connection = entry.connection;
+        EventLoop::shared().post(entry.loop, [connection]() { connection->wake(); });
+    }
+}
+
+void DownloadEngine::cancelDownload() {
+    should_cancel_.store(true);
+    {
+        std::lock_guard<std::mutex> lock(pause_mutex_);
+        is_paused_.store(false);
+    }
+    wakeParked();
+    write_behind_.interrupt();
+    
+    // The supervisor waits for connections on the event loop and, in
+    // finishDownload, for the reporter's last sample. Called from either of
+    // those threads (a progress callback cancelling its own download), or
+    // from the supervisor itself, only signal; the supervisor still
+    // finishes the download.
+    if (EventLoop::shared().isLoopThread() || ProgressReporter::shared().isReporterThread() ||
+        supervisor_.get_id() == std::this_thread::get_id()) {
+        LOGD("Download cancel requested");
+        return;
+    }
+    
+    if (supervisor_.joinable()) {
+        supervisor_.join();
+    }
+    {
+        std::unique_lock<std::mutex> lock(async_mutex_);
+        async_cv_.wait(lock, [this] { return !async_running_; });
+    }
+    
+    worker_threads_.clear();
+    LOGD("Download cancelled");
+}
+
+int64_t DownloadEngine::progressHandle() const {
+    return ProgressBoard::shared().handle(progress_slot_);
 }
 
 DownloadProgress DownloadEngine::getProgress() const {
     DownloadProgress progress;
-    progress.downloaded_bytes = downloaded_bytes_.load();
+    progress.downloaded_bytes = downloadedBytes();
     progress.total_bytes = total_bytes_.load();
     progress.speed_bps = current_speed_.load();
-    progress.active_connections = static_cast<int>(chunks_.size());
+    progress.active_connections = active_connections_.load();
+    progress.eta_seconds = eta_seconds_.load();
+    progress.decoded_bytes = streaming_ ? decoded_bytes_.load(std::memory_order_relaxed)
+                                        : progress.downloaded_bytes;
+    progress.segments = scheduler_.snapshot();
     return progress;
 }
 
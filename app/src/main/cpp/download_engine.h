@@ -7,27 +7,152 @@
 #include <atomic>
 #include <memory>
 #include <functional>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <sys/types.h>
+#include "segment_scheduler.h"
+#include "resume_journal.h"
+#include "http_response.h"
+#include "metadata_cache.h"
+#include "dns_resolver.h"
+#include "rate_limiter.h"
+#include "integrity.h"
+#include "inflater.h"
+#include "connection_stats.h"
+#include "connection_tuner.h"
+#include "splice_pipe.h"
+#include "write_behind.h"
+#include "mirror_set.h"
 
 namespace orion {
 
 struct DownloadProgress {
+    // Bytes received off the wire; decoded_bytes is what reached the file.
     int64_t downloaded_bytes;
     int64_t total_bytes;
     double speed_bps;
     int active_connections;
+    int64_t eta_seconds;
+    int64_t decoded_bytes;
+    std::vector<SegmentProgress> segments;
 };
 
 using ProgressCallback = std::function<void(const DownloadProgress&)>;
 
-struct ChunkInfo {
-    int64_t start;
-    int64_t end;
-    int64_t downloaded;
-    bool completed;
+enum class DownloadOutcome {
+    None = 0,
+    Completed = 1,
+    Failed = 2,
+    Cancelled = 3,
+    // The server still has the local copy's validators; nothing was fetched.
+    Unchanged = 4
 };
 
+enum class FailureReason {
+    None = 0,
+    // Connect, send or receive kept failing until the retry budget ran out.
+    Network = 1,
+    // The server answered a range with a status retrying will not change.
+    HttpStatus = 2,
+    RemoteChanged = 3,
+    Storage = 4,
+    Integrity = 5
+};
+
+struct DownloadResult {
+    DownloadOutcome outcome = DownloadOutcome::None;
+    FailureReason reason = FailureReason::None;
+    // Last unexpected HTTP status, 0 if every response was as asked.
+    int http_status = 0;
+    // Segment retries spent across all connections.
+    int retries = 0;
+    // Bytes taken from the local copy instead of the network.
+    int64_t reused_bytes = 0;
+};
+
+enum class IoBackend {
+    Threaded = 0,
+    EventLoop = 1,
+    // Threaded, but fixed-length bodies are spliced from the socket into the
+    // file. Falls back to Threaded where the kernel or filesystem refuses,
+    // and while integrity hashing needs the bytes in user space.
+    Splice = 2
+};
+
+struct DownloadOptions {
+    // DownloadEngine::AUTO_CONNECTIONS lets measured throughput pick the count.
+    int num_connections = 8;
+    IoBackend io_backend = IoBackend::Threaded;
+    bool pipeline_requests = false;
+    // Bytes per second for this download alone; 0 leaves it uncapped.
+    int64_t rate_limit = 0;
+    IntegrityOptions integrity;
+    // Sends Accept-Encoding and inflates gzip/deflate bodies as they arrive.
+    // Forces a single stream, since ranges would address the encoded bytes.
+    bool decompress = false;
+    // Per-connection timings and histograms for getStats(); off costs a
+    // pointer test per read and write.
+    bool collect_stats = false;
+    // Receive buffers for a dedicated writer thread, 64 KiB each; 0 writes
+    // on the receiving thread. Bodies fetched by range only.
+    int write_behind_buffers = 0;
+    // fdatasync after this many write-behind bytes; 0 leaves it to the journal.
+    int64_t write_sync_bytes = 0;
+    // Once no more than this is left and nothing can be split, idle
+    // connections race duplicate requests for ranges that lag behind; 0
+    // disables.
+    int64_t endgame_bytes = 2 * 1024 * 1024;
+    // Further URLs for the same file. Each is probed up front and used only
+    // if it agrees with the first on length, range support and validator.
+    std::vector<std::string> mirrors;
+    // Block manifest for delta updates (see DeltaSync). When output_path
+    // holds an older copy, only the blocks missing from it are fetched.
+    std::string delta_manifest_url;
+    // Validators the local copy was downloaded with. If the server still
+    // reports either, the download is skipped.
+    std::string local_etag;
+    std::string local_last_modified;
+};
+
+// Padded so each connection's counter sits on its own cache line.
+struct alignas(64) ByteCounter {
+    std::atomic<int64_t> bytes{0};
+};
+
+struct HttpConnection {
+    std::string host;
+    std::string path;
+    int port = 80;
+    // Index into the download's MirrorSet; host, path and port follow it.
+    int mirror = -1;
+    int fd = -1;
+    bool reusable = false;
+    bool has_pipelined = false;
+    SegmentLease pipelined = {-1, 0, 0};
+    std::vector<char> buffer;
+    size_t buffer_start = 0;
+    size_t buffer_end = 0;
+    HttpResponseParser parser;
+    bool response_open = false;
+    ConnectionTimings* timings = nullptr;
+    // Body bytes consumed so far; a failed attempt that moved this still
+    // counts as progress and starts the backoff over.
+    int64_t body_bytes = 0;
+    SplicePipe pipe;
+    // Set while write-behind runs; receives then land in arena buffers.
+    BufferArena* arena = nullptr;
+    int arena_buffer = -1;
+};
+
+class AsyncConnection;
+class ProgressReporter;
+
 class DownloadEngine {
 public:
+    static constexpr int AUTO_CONNECTIONS = 0;
+
     DownloadEngine();
     ~DownloadEngine();
     
@@ -36,33 +161,175 @@ public:
                       int num_connections = 8,
                       ProgressCallback progress_callback = nullptr);
     
+    bool startDownload(const std::string& url,
+                       const std::string& output_path,
+                       const DownloadOptions& options,
+                       ProgressCallback progress_callback = nullptr);
+    
+    bool resumeFromJournal(const std::string& output_path,
+                           int num_connections = 8,
+                           ProgressCallback progress_callback = nullptr);
+    
+    bool resumeFromJournal(const std::string& output_path,
+                           const DownloadOptions& options,
+                           ProgressCallback progress_callback = nullptr);
+    
     void pauseDownload();
     void resumeDownload();
     void cancelDownload();
     
+    void setRateLimit(int64_t bytes_per_second);
+    static void setGlobalRateLimit(int64_t bytes_per_second);
+    
     bool isDownloading() const { return is_downloading_.load(); }
     bool isPaused() const { return is_paused_.load(); }
     
     DownloadProgress getProgress() const;
+    IntegrityResult getIntegrity() const;
+    DownloadResult getResult() const;
+    DownloadStats getStats() const;
+    // Locates this engine's slot on the shared ProgressBoard.
+    int64_t progressHandle() const;
     
     int64_t getContentLength(const std::string& url);
     bool supportsRangeRequests(const std::string& url);
+    bool probe(const std::string& url, ResourceInfo& info);
+    
+    bool prepareDownload(const std::string& url,
+                         const std::string& output_path,
+                         int num_connections,
+                         ProgressCallback progress_callback);
+    bool runConnection(int connection_id);
+    bool hasPendingWork() const;
+    bool finishDownload();
+    int connectionTarget() const { return adaptive_ ? tuner_.target() : num_connections_; }
+    int activeConnections() const { return active_connections_.load(); }
+    
+    static std::string hostKey(const std::string& url);
+    static void prefetchHost(const std::string& url);
 
 private:
+    friend class AsyncConnection;
+    friend class ProgressReporter;
+    
+    static constexpr int COUNTER_SLOTS = 16;
+    
+    bool probeResource(const std::string& url, ResourceInfo& info, int64_t span,
+                       HttpConnection* handoff, ConnectionTimings* timings = nullptr);
     bool initializeDownload(const std::string& url);
-    void downloadChunk(int chunk_id, const std::string& url, const std::string& output_path);
-    void mergeChunks(const std::string& output_path);
+    bool addMirror(const std::string& url, const std::string& etag);
+    void probeMirrors(const ResourceInfo& primary);
+    bool chooseMirror(HttpConnection& connection);
+    bool fetchBody(const std::string& url, std::string& body, size_t limit);
+    bool localCopyCurrent(const std::string& output_path) const;
+    bool prepareDelta(const std::string& output_path);
+    bool prepareOutputFile(const std::string& output_path, int64_t size, bool keep_existing);
+    void closeOutputFile();
+    void resetDownload(const std::string& url, int num_connections,
+                       ProgressCallback progress_callback);
+    void chooseConnections(const std::string& url, int requested);
+    bool launchWorkers();
+    bool launchAsync();
+    bool launchConnection();
+    bool retireConnection();
+    void adjustConnections();
+    void onAsyncConnectionDone();
+    void waitWhilePaused();
+    bool parkConnection(AsyncConnection* connection, int loop);
+    void wakeParked();
+    void fail(FailureReason reason);
+    int64_t nextRetryDelay(int attempt);
+    void waitBeforeRetry(int attempt);
+    bool consumeBody(int connection_id, const SegmentLease& lease, const char* data,
+                     size_t length, bool& finished, ConnectionTimings* timings,
+                     int arena_buffer = -1);
+    void onWritten(const char* data, int64_t length, int64_t offset);
+    bool downloadSegment(int connection_id, const SegmentLease& lease,
+                         HttpConnection& connection, bool request_sent);
+    void dropConnection(HttpConnection& connection);
+    bool openResponse(HttpConnection& connection, const std::string& request,
+                      bool request_sent, bool head_request);
+    bool acceptRangeResponse(const HttpResponse& response, const SegmentLease& lease,
+                             int mirror);
+    bool streamBody(int connection_id, HttpConnection& connection);
+    bool spliceBody(int connection_id, const SegmentLease& lease,
+                    HttpConnection& connection, bool& finished);
+    bool verifyWritten(const char* data, int64_t length, int64_t offset);
+    void trackReceiver(int segment_id, int fd);
+    void untrackReceiver(int segment_id);
+    void stopTwin(int segment_id);
+    void recordBytes(int connection_id, int64_t bytes);
+    int64_t downloadedBytes() const;
+    void beginProgress(int64_t resumed_bytes);
+    void sampleProgress(int64_t now_ms);
+    size_t admitRead(size_t wanted, int64_t& wait_us);
+    void settleRead(size_t admitted, ssize_t received);
+    void throttle(int64_t wait_us, ConnectionTimings* timings);
+    ssize_t receive(HttpConnection& connection);
     
     std::atomic<bool> is_downloading_;
     std::atomic<bool> is_paused_;
     std::atomic<bool> should_cancel_;
     std::atomic<int64_t> total_bytes_;
-    std::atomic<int64_t> downloaded_bytes_;
+    std::atomic<int64_t> resumed_bytes_;
+    std::atomic<int64_t> decoded_bytes_;
+    std::atomic<int64_t> reused_bytes_;
+    std::atomic<int> outcome_;
+    std::atomic<int> failure_reason_;
+    std::atomic<int> http_status_;
+    std::atomic<int> retries_;
+    ByteCounter counters_[COUNTER_SLOTS];
     std::atomic<double> current_speed_;
+    std::atomic<int64_t> eta_seconds_;
+    int64_t sample_bytes_;
+    int64_t sample_ms_;
+    int progress_slot_;
+    std::atomic<int> active_connections_;
+    std::atomic<bool> splice_enabled_;
+    // Paused workers drop their socket and lease and wait here; pause state
+    // changes under pause_mutex_ so a wakeup cannot slip past a waiter.
+    struct ParkedConnection {
+        AsyncConnection* connection;
+        int loop;
+    };
+    std::mutex pause_mutex_;
+    std::condition_variable pause_cv_;
+    std::vector<ParkedConnection> parked_;
+    bool parks_workers_;
+    // Segment id -> socket of the threaded connection reading it.
+    std::mutex receivers_mutex_;
+    std::unordered_map<int, int> receivers_;
     
+    std::string url_;
+    std::string source_url_;
+    DownloadOptions options_;
     int num_connections_;
-    std::vector<ChunkInfo> chunks_;
+    bool adaptive_;
+    int output_fd_;
+    bool supports_ranges_;
+    bool streaming_;
+    bool stream_complete_;
+    std::string remote_etag_;
+    std::string remote_last_modified_;
+    SegmentScheduler scheduler_;
+    ResumeJournal journal_;
+    HttpConnection probe_connection_;
     std::vector<std::unique_ptr<std::thread>> worker_threads_;
+    std::mutex workers_mutex_;
+    std::thread supervisor_;
+    // Connections still running; adaptive threaded downloads count here too.
+    std::atomic<int> live_connections_;
+    std::atomic<int> next_connection_id_;
+    bool async_running_;
+    std::mutex async_mutex_;
+    std::condition_variable async_cv_;
+    MirrorSet mirrors_;
+    RateLimiter rate_limiter_;
+    IntegrityVerifier verifier_;
+    Inflater inflater_;
+    StatsRecorder stats_;
+    ConnectionTuner tuner_;
+    WriteBehind write_behind_;
     ProgressCallback progress_callback_;
 };
 
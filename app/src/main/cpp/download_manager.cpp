@@ -0,0 +1,342 @@
+#include "download_manager.h"
+#include "log.h"
+#include <algorithm>
+#include <vector>
+
+#define LOG_TAG "OrionManager"
+#define LOGD(...) orion::logPrint(orion::LogLevel::Debug, LOG_TAG, __VA_ARGS__)
+#define LOGI(...) orion::logPrint(orion::LogLevel::Info, LOG_TAG, __VA_ARGS__)
+
+namespace orion {
+
+DownloadManager::DownloadManager(int max_connections, int max_connections_per_host)
+    : active_connections_(0)
+    , max_connections_(std::min(std::max(max_connections, 1), 64))
+    , max_connections_per_host_(std::max(max_connections_per_host, 1))
+    , next_job_id_(1)
+    , pool_(new WorkerPool(max_connections_)) {
+    LOGI("DownloadManager created: %d connections, %d per host",
+         max_connections_, max_connections_per_host_);
+}
+
+DownloadManager::~DownloadManager() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& entry : jobs_) {
+            entry.second->cancel_requested = true;
+            if (entry.second->engine) {
+                entry.second->engine->cancelDownload();
+            }
+        }
+    }
+    pool_->shutdown();
+}
+
+int64_t DownloadManager::submit(const std::string& url,
+                                const std::string& output_path,
+                                int priority,
+                                int max_connections,
+                                ProgressCallback progress_callback,
+                                JobFinishedCallback finished_callback) {
+    auto job = std::make_shared<Job>();
+    job->url = url;
+    job->output_path = output_path;
+    job->host = DownloadEngine::hostKey(url);
+    job->priority = priority;
+    job->max_connections = std::min(std::max(max_connections, 1), 16);
+    job->state = JobState::Queued;
+    job->paused = false;
+    job->cancel_requested = false;
+    job->connection_failed = false;
+    job->finishing = false;
+    job->running = 0;
+    job->next_connection_id = 0;
+    job->engine.reset(new DownloadEngine());
+    job->progress_callback = progress_callback;
+    job->finished_callback = finished_callback;
+
+    if (job->host.empty()) {
+        return -1;
+    }
+    DownloadEngine::prefetchHost(url);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    job->id = next_job_id_++;
+    jobs_[job->id] = job;
+    LOGD("Job %lld queued (priority %d): %s", (long long)job->id, priority, url.c_str());
+    scheduleLocked();
+    return job->id;
+}
+
+bool DownloadManager::grantLocked(const std::shared_ptr<Job>& job) {
+    if (active_connections_ >= max_connections_) return false;
+    if (job->paused || job->cancel_requested || job->connection_failed || job->finishing) {
+        return false;
+    }
+    if (host_connections_[job->host] >= max_connections_per_host_) return false;
+
+    if (job->state == JobState::Queued) {
+        job->state = JobState::Preparing;
+    } else if (job->state != JobState::Active ||
+               job->running >= std::min(job->max_connections, job->engine->connectionTarget()) ||
+               !job->engine->hasPendingWork()) {
+        return false;
+    }
+
+    active_connections_++;
+    host_connections_[job->host]++;
+    job->running++;
+
+    if (job->state == JobState::Preparing) {
+        pool_->submit([this, job]() { runPrepare(job); });
+    } else {
+        int connection_id = job->next_connection_id++;
+        pool_->submit([this, job, connection_id]() { runConnection(job, connection_id); });
+    }
+    return true;
+}
+
+void DownloadManager::scheduleLocked() {
+    std::vector<std::shared_ptr<Job>> order;
+    for (auto& entry : jobs_) {
+        JobState state = entry.second->state;
+        if (state == JobState::Queued || state == JobState::Active) {
+            order.push_back(entry.second);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [](const std::shared_ptr<Job>& a, const std::shared_ptr<Job>& b) {
+                         return a->priority > b->priority;
+                     });
+
+    // Strict priority between levels, round-robin inside a level.
+    size_t level_begin = 0;
+    while (level_begin < order.size() && active_connections_ < max_connections_) {
+        size_t level_end = level_begin;
+        while (level_end < order.size() && order[level_end]->priority == order[level_begin]->priority) {
+            level_end++;
+        }
+
+        bool granted = true;
+        while (granted && active_connections_ < max_connections_) {
+            granted = false;
+            for (size_t i = level_begin; i < level_end; ++i) {
+                granted |= grantLocked(order[i]);
+            }
+        }
+        level_begin = level_end;
+    }
+}
+
+void DownloadManager::runPrepare(const std::shared_ptr<Job>& job) {
+    bool prepared = job->engine->prepareDownload(job->url, job->output_path,
+                                                 job->max_connections, job->progress_callback);
+
+    int connection_id = 0;
+    bool paused = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (prepared) {
+            job->state = JobState::Active;
+            if (job->cancel_requested) {
+                job->engine->cancelDownload();
+            }
+            // prepareDownload clears the engine's pause, so one requested
+            // while preparing is applied again here.
+            paused = job->paused && !job->cancel_requested;
+            if (paused) {
+                job->engine->pauseDownload();
+            } else {
+                connection_id = job->next_connection_id++;
+            }
+            scheduleLocked();
+        }
+    }
+
+    if (!prepared) {
+        onConnectionDone(job, false);
+        return;
+    }
+    // The slot goes back; resume() schedules connections again.
+    if (paused) {
+        onConnectionDone(job, true);
+        return;
+    }
+
+    runConnection(job, connection_id);
+}
+
+void DownloadManager::runConnection(const std::shared_ptr<Job>& job, int connection_id) {
+    bool ok = job->engine->runConnection(connection_id);
+    onConnectionDone(job, ok);
+}
+
+void DownloadManager::onConnectionDone(const std::shared_ptr<Job>& job, bool ok) {
+    JobState final_state = JobState::Unknown;
+    bool finish = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_connections_--;
+        host_connections_[job->host]--;
+        job->running--;
+        if (!ok) {
+            job->connection_failed = true;
+        }
+
+        if (job->running == 0) {
+            if (job->state == JobState::Preparing) {
+                final_state = job->cancel_requested ? JobState::Cancelled : JobState::Failed;
+            } else if (job->state == JobState::Active &&
+                       !job->finishing &&
+                       (job->cancel_requested || job->connection_failed ||
+                        !job->engine->hasPendingWork())) {
+                job->finishing = true;
+                finish = true;
+            }
+            if (final_state != JobState::Unknown) {
+                job->state = final_state;
+            }
+        }
+
+        scheduleLocked();
+    }
+
+    if (finish) {
+        completeJob(job);
+    } else if (final_state != JobState::Unknown) {
+        finishJob(job, final_state);
+    }
+}
+
+// finishDownload may read the whole file back and delivers the last
+// progress callback, which can call into the manager, so it runs without
+// mutex_. finishing keeps the job off the schedule meanwhile.
+void DownloadManager::completeJob(const std::shared_ptr<Job>& job) {
+    bool complete = job->engine->finishDownload();
+    JobState state;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        state = complete ? JobState::Completed
+              : job->cancel_requested ? JobState::Cancelled : JobState::Failed;
+        job->state = state;
+        job->finishing = false;
+        scheduleLocked();
+    }
+    finishJob(job, state);
+}
+
+void DownloadManager::finishJob(const std::shared_ptr<Job>& job, JobState state) {
+    LOGI("Job %lld finished with state %d", (long long)job->id, static_cast<int>(state));
+    if (job->finished_callback) {
+        job->finished_callback(job->id, state);
+    }
+}
+
+bool DownloadManager::cancel(int64_t job_id) {
+    std::shared_ptr<Job> finished;
+    std::shared_ptr<Job> idle;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = jobs_.find(job_id);
+        if (it == jobs_.end()) return false;
+        auto& job = it->second;
+        if (job->state == JobState::Completed || job->state == JobState::Failed ||
+            job->state == JobState::Cancelled) {
+            return false;
+        }
+
+        job->cancel_requested = true;
+        if (job->state == JobState::Queued) {
+            job->state = JobState::Cancelled;
+            finished = job;
+        } else if (job->state == JobState::Active) {
+            job->engine->cancelDownload();
+            // Paused before its first connection, so none is left to finish it.
+            if (job->running == 0 && !job->finishing) {
+                job->finishing = true;
+                idle = job;
+            }
+        }
+    }
+
+    if (finished) {
+        finishJob(finished, JobState::Cancelled);
+    } else if (idle) {
+        completeJob(idle);
+    }
+    return true;
+}
+
+bool DownloadManager::pause(int64_t job_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = jobs_.find(job_id);
+    if (it == jobs_.end()) return false;
+    it->second->paused = true;
+    it->second->engine->pauseDownload();
+    return true;
+}
+
+bool DownloadManager::resume(int64_t job_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = jobs_.find(job_id);
+    if (it == jobs_.end()) return false;
+    it->second->paused = false;
+    it->second->engine->resumeDownload();
+    scheduleLocked();
+    return true;
+}
+
+bool DownloadManager::setRateLimit(int64_t job_id, int64_t bytes_per_second) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = jobs_.find(job_id);
+    if (it == jobs_.end()) return false;
+    it->second->engine->setRateLimit(bytes_per_second);
+    return true;
+}
+
+bool DownloadManager::setPriority(int64_t job_id, int priority) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = jobs_.find(job_id);
+    if (it == jobs_.end()) return false;
+    it->second->priority = priority;
+    scheduleLocked();
+    return true;
+}
+
+void DownloadManager::release(int64_t job_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = jobs_.find(job_id);
+    if (it == jobs_.end()) return;
+    JobState state = it->second->state;
+    if (state == JobState::Completed || state == JobState::Failed || state == JobState::Cancelled) {
+        jobs_.erase(it);
+    }
+}
+
+JobState DownloadManager::getState(int64_t job_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = jobs_.find(job_id);
+    if (it == jobs_.end()) return JobState::Unknown;
+    return it->second->state;
+}
+
+bool DownloadManager::getProgress(int64_t job_id, DownloadProgress& progress) const {
+    std::shared_ptr<Job> job;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = jobs_.find(job_id);
+        if (it == jobs_.end()) return false;
+        job = it->second;
+    }
+    progress = job->engine->getProgress();
+    return true;
+}
+
+int64_t DownloadManager::progressHandle(int64_t job_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = jobs_.find(job_id);
+    if (it == jobs_.end()) return -1;
+    return it->second->engine->progressHandle();
+}
+
+}
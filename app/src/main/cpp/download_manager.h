@@ -0,0 +1,92 @@
+#ifndef ORION_DOWNLOAD_MANAGER_H
+#define ORION_DOWNLOAD_MANAGER_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "download_engine.h"
+#include "worker_pool.h"
+
+namespace orion {
+
+enum class JobState {
+    Queued = 0,
+    Preparing = 1,
+    Active = 2,
+    Completed = 3,
+    Failed = 4,
+    Cancelled = 5,
+    Unknown = -1
+};
+
+using JobFinishedCallback = std::function<void(int64_t job_id, JobState state)>;
+
+// Runs many downloads on one shared pool. Every pool thread carries at most
+// one connection, so the pool size is the global connection budget; slots
+// are handed out by priority and capped per host.
+class DownloadManager {
+public:
+    DownloadManager(int max_connections = 16, int max_connections_per_host = 6);
+    ~DownloadManager();
+
+    int64_t submit(const std::string& url,
+                   const std::string& output_path,
+                   int priority = 0,
+                   int max_connections = 8,
+                   ProgressCallback progress_callback = nullptr,
+                   JobFinishedCallback finished_callback = nullptr);
+
+    bool cancel(int64_t job_id);
+    bool pause(int64_t job_id);
+    bool resume(int64_t job_id);
+    bool setPriority(int64_t job_id, int priority);
+    bool setRateLimit(int64_t job_id, int64_t bytes_per_second);
+    void release(int64_t job_id);
+
+    JobState getState(int64_t job_id) const;
+    bool getProgress(int64_t job_id, DownloadProgress& progress) const;
+    int64_t progressHandle(int64_t job_id) const;
+
+private:
+    struct Job {
+        int64_t id;
+        std::string url;
+        std::string output_path;
+        std::string host;
+        int priority;
+        int max_connections;
+        JobState state;
+        bool paused;
+        bool cancel_requested;
+        bool connection_failed;
+        // finishDownload is running outside the lock.
+        bool finishing;
+        int running;
+        int next_connection_id;
+        std::unique_ptr<DownloadEngine> engine;
+        ProgressCallback progress_callback;
+        JobFinishedCallback finished_callback;
+    };
+
+    void scheduleLocked();
+    bool grantLocked(const std::shared_ptr<Job>& job);
+    void runPrepare(const std::shared_ptr<Job>& job);
+    void runConnection(const std::shared_ptr<Job>& job, int connection_id);
+    void onConnectionDone(const std::shared_ptr<Job>& job, bool ok);
+    void completeJob(const std::shared_ptr<Job>& job);
+    void finishJob(const std::shared_ptr<Job>& job, JobState state);
+
+    mutable std::mutex mutex_;
+    std::map<int64_t, std::shared_ptr<Job>> jobs_;
+    std::map<std::string, int> host_connections_;
+    int active_connections_;
+    int max_connections_;
+    int max_connections_per_host_;
+    int64_t next_job_id_;
+    std::unique_ptr<WorkerPool> pool_;
+};
+
+}
+
+#endif
@@ -0,0 +1,189 @@
+#include "event_loop.h"
+#include "log.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+
+#define LOG_TAG "OrionEventLoop"
+#define LOGE(...) orion::logPrint(orion::LogLevel::Error, LOG_TAG, __VA_ARGS__)
+
+namespace orion {
+
+constexpr int TICK_INTERVAL_MS = 250;
+constexpr int MAX_EVENTS = 64;
+
+static int64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+EventLoop& EventLoop::shared() {
+    static EventLoop instance(std::min(std::max(static_cast<int>(std::thread::hardware_concurrency()), 1), 4));
+    return instance;
+}
+
+EventLoop::EventLoop(int num_threads)
+    : next_loop_(0)
+    , stopping_(false) {
+    for (int i = 0; i < std::max(num_threads, 1); ++i) {
+        auto loop = std::make_unique<Loop>();
+        loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        loop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        loop->buffer.reset(new char[SCRATCH_SIZE]);
+
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wake_fd, &event);
+
+        loop->thread = std::thread(&EventLoop::run, this, loop.get());
+        loops_.push_back(std::move(loop));
+    }
+}
+
+EventLoop::~EventLoop() {
+    stopping_.store(true);
+    for (auto& loop : loops_) {
+        uint64_t one = 1;
+        ssize_t ignored = write(loop->wake_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+    for (auto& loop : loops_) {
+        if (loop->thread.joinable()) {
+            loop->thread.join();
+        }
+        close(loop->epoll_fd);
+        close(loop->wake_fd);
+    }
+}
+
+int EventLoop::pick() {
+    return static_cast<int>(next_loop_.fetch_add(1) % loops_.size());
+}
+
+void EventLoop::post(int loop, std::function<void()> task) {
+    Loop* target = loops_[loop].get();
+    {
+        std::lock_guard<std::mutex> lock(target->mutex);
+        target->tasks.push_back(std::move(task));
+    }
+    uint64_t one = 1;
+    ssize_t ignored = write(target->wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+bool EventLoop::watch(int loop, int fd, uint32_t events, EventHandler* handler) {
+    struct epoll_event event = {};
+    event.events = events;
+    event.data.ptr = handler;
+    if (epoll_ctl(loops_[loop]->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        LOGE("epoll add failed: %d", errno);
+        return false;
+    }
+    loops_[loop]->handlers.insert(handler);
+    return true;
+}
+
+bool EventLoop::modify(int loop, int fd, uint32_t events, EventHandler* handler) {
+    struct epoll_event event = {};
+    event.events = events;
+    event.data.ptr = handler;
+    return epoll_ctl(loops_[loop]->epoll_fd, EPOLL_CTL_MOD, fd, &event) == 0;
+}
+
+void EventLoop::unwatch(int loop, int fd, EventHandler* handler) {
+    if (fd >= 0) {
+        epoll_ctl(loops_[loop]->epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+    loops_[loop]->handlers.erase(handler);
+
+    auto& timers = loops_[loop]->timers;
+    for (auto it = timers.begin(); it != timers.end();) {
+        it = it->second == handler ? timers.erase(it) : std::next(it);
+    }
+}
+
+void EventLoop::attach(int loop, EventHandler* handler) {
+    loops_[loop]->handlers.insert(handler);
+}
+
+void EventLoop::wakeAt(int loop, int64_t when_ms, EventHandler* handler) {
+    loops_[loop]->timers.emplace(when_ms, handler);
+}
+
+char* EventLoop::scratch(int loop) {
+    return loops_[loop]->buffer.get();
+}
+
+bool EventLoop::isLoopThread() const {
+    for (const auto& loop : loops_) {
+        if (loop->thread.get_id() == std::this_thread::get_id()) return true;
+    }
+    return false;
+}
+
+void EventLoop::run(Loop* loop) {
+    struct epoll_event events[MAX_EVENTS];
+    int64_t last_tick = nowMs();
+
+    while (!stopping_.load()) {
+        int timeout = TICK_INTERVAL_MS;
+        if (!loop->timers.empty()) {
+            int64_t until = loop->timers.begin()->first - nowMs();
+            timeout = static_cast<int>(std::min<int64_t>(std::max<int64_t>(until, 0), timeout));
+        }
+
+        int count = epoll_wait(loop->epoll_fd, events, MAX_EVENTS, timeout);
+        if (count < 0 && errno != EINTR) {
+            LOGE("epoll_wait failed: %d", errno);
+            break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            auto* handler = static_cast<EventHandler*>(events[i].data.ptr);
+            if (handler == nullptr) {
+                uint64_t value;
+                ssize_t ignored = read(loop->wake_fd, &value, sizeof(value));
+                (void)ignored;
+                continue;
+            }
+            // A handler earlier in this batch may have unwatched this one.
+            if (loop->handlers.count(handler)) {
+                handler->onEvent(events[i].events);
+            }
+        }
+
+        std::vector<std::function<void()>> tasks;
+        {
+            std::lock_guard<std::mutex> lock(loop->mutex);
+            tasks.swap(loop->tasks);
+        }
+        for (auto& task : tasks) {
+            task();
+        }
+
+        int64_t now = nowMs();
+        while (!loop->timers.empty() && loop->timers.begin()->first <= now) {
+            EventHandler* handler = loop->timers.begin()->second;
+            loop->timers.erase(loop->timers.begin());
+            if (loop->handlers.count(handler)) {
+                handler->onTimer(now);
+            }
+        }
+
+        if (now - last_tick >= TICK_INTERVAL_MS) {
+            last_tick = now;
+            std::vector<EventHandler*> handlers(loop->handlers.begin(), loop->handlers.end());
+            for (auto* handler : handlers) {
+                if (loop->handlers.count(handler)) {
+                    handler->onTick(now);
+                }
+            }
+        }
+    }
+}
+
+}
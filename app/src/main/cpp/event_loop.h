@@ -0,0 +1,74 @@
+#ifndef ORION_EVENT_LOOP_H
+#define ORION_EVENT_LOOP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace orion {
+
+class EventHandler {
+public:
+    virtual ~EventHandler() = default;
+    virtual void onEvent(uint32_t events) = 0;
+    virtual void onTick(int64_t now_ms) = 0;
+    virtual void onTimer(int64_t now_ms) {}
+};
+
+// A small set of epoll threads shared by every download. Handlers are pinned
+// to one loop; watch/unwatch/modify must only be called from that loop's
+// thread (use post() to get there). Each loop owns one receive buffer that
+// its handlers borrow, so idle connections cost no buffer memory.
+class EventLoop {
+public:
+    static constexpr size_t SCRATCH_SIZE = 65536;
+
+    static EventLoop& shared();
+
+    explicit EventLoop(int num_threads);
+    ~EventLoop();
+
+    int pick();
+    void post(int loop, std::function<void()> task);
+
+    bool watch(int loop, int fd, uint32_t events, EventHandler* handler);
+    bool modify(int loop, int fd, uint32_t events, EventHandler* handler);
+    void unwatch(int loop, int fd, EventHandler* handler);
+    // Registers a handler without a socket so it still gets ticks and
+    // timers, e.g. while backing off; unwatch(loop, -1, handler) ends it.
+    void attach(int loop, EventHandler* handler);
+    // One-shot onTimer() call, dropped if the handler is unwatched first.
+    void wakeAt(int loop, int64_t when_ms, EventHandler* handler);
+
+    char* scratch(int loop);
+    bool isLoopThread() const;
+
+private:
+    struct Loop {
+        int epoll_fd;
+        int wake_fd;
+        std::thread thread;
+        std::mutex mutex;
+        std::vector<std::function<void()>> tasks;
+        std::unordered_set<EventHandler*> handlers;
+        std::multimap<int64_t, EventHandler*> timers;
+        std::unique_ptr<char[]> buffer;
+    };
+
+    void run(Loop* loop);
+
+    std::vector<std::unique_ptr<Loop>> loops_;
+    std::atomic<unsigned> next_loop_;
+    std::atomic<bool> stopping_;
+};
+
+}
+
+#endif
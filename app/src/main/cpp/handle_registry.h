@@ -0,0 +1,63 @@
+#ifndef ORION_HANDLE_REGISTRY_H
+#define ORION_HANDLE_REGISTRY_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace orion {
+
+// Maps opaque handles handed to Kotlin onto shared owners. Handles are
+// spread over independently locked shards, and a lookup holds its shard
+// only long enough to copy the pointer: callers never run engine code
+// under a registry lock, and a call still in flight keeps its object
+// alive after remove().
+template <typename T>
+class HandleRegistry {
+public:
+    int64_t add(std::shared_ptr<T> object) {
+        int64_t handle = next_handle_.fetch_add(1, std::memory_order_relaxed);
+        Shard& shard = shardFor(handle);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.objects.emplace(handle, std::move(object));
+        return handle;
+    }
+
+    std::shared_ptr<T> find(int64_t handle) {
+        Shard& shard = shardFor(handle);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.objects.find(handle);
+        return it == shard.objects.end() ? nullptr : it->second;
+    }
+
+    std::shared_ptr<T> remove(int64_t handle) {
+        Shard& shard = shardFor(handle);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.objects.find(handle);
+        if (it == shard.objects.end()) return nullptr;
+        std::shared_ptr<T> object = std::move(it->second);
+        shard.objects.erase(it);
+        return object;
+    }
+
+private:
+    static constexpr int SHARD_COUNT = 16;
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<int64_t, std::shared_ptr<T>> objects;
+    };
+
+    Shard& shardFor(int64_t handle) {
+        return shards_[static_cast<uint64_t>(handle) % SHARD_COUNT];
+    }
+
+    Shard shards_[SHARD_COUNT];
+    std::atomic<int64_t> next_handle_{1};
+};
+
+}
+
+#endif
@@ -0,0 +1,287 @@
+#include "http_response.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace orion {
+
+constexpr size_t MAX_HEADER_SIZE = 16384;
+
+static std::string trim(const std::string& value) {
+    size_t begin = value.find_first_not_of(" \t");
+    if (begin == std::string::npos) return "";
+    size_t end = value.find_last_not_of(" \t\r");
+    return value.substr(begin, end - begin + 1);
+}
+
+static std::string lowercase(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return static_cast<char>(::tolower(c)); });
+    return value;
+}
+
+const std::string& HttpResponse::header(const std::string& name) const {
+    static const std::string empty;
+    for (const auto& entry : headers) {
+        if (entry.first == name) return entry.second;
+    }
+    return empty;
+}
+
+HttpResponseParser::HttpResponseParser() {
+    reset();
+}
+
+void HttpResponseParser::reset(bool head_request) {
+    state_ = State::Headers;
+    chunk_state_ = ChunkState::Size;
+    response_ = HttpResponse();
+    header_block_.clear();
+    line_start_ = 0;
+    body_left_ = -1;
+    chunk_size_ = 0;
+    size_digits_ = 0;
+    head_request_ = head_request;
+    until_close_ = false;
+    trailer_line_empty_ = true;
+}
+
+int64_t HttpResponseParser::remaining() const {
+    if (state_ == State::Done) return 0;
+    if (state_ != State::Body || response_.chunked || until_close_) return -1;
+    return body_left_;
+}
+
+void HttpResponseParser::skipBody(int64_t length) {
+    body_left_ -= std::min(length, body_left_);
+    if (body_left_ == 0) state_ = State::Done;
+}
+
+size_t HttpResponseParser::feed(const char* data, size_t length,
+                                const char*& body, size_t& body_length) {
+    body = nullptr;
+    body_length = 0;
+
+    switch (state_) {
+        case State::Headers:
+            return feedHeaders(data, length);
+        case State::Body:
+            break;
+        default:
+            return 0;
+    }
+
+    if (response_.chunked) {
+        return feedChunked(data, length, body, body_length);
+    }
+
+    size_t take = length;
+    if (!until_close_) {
+        take = static_cast<size_t>(std::min<int64_t>(body_left_, static_cast<int64_t>(length)));
+        body_left_ -= take;
+        if (body_left_ == 0) state_ = State::Done;
+    }
+    body = data;
+    body_length = take;
+    return take;
+}
+
+bool HttpResponseParser::finishOnClose() {
+    if (state_ == State::Body && until_close_) {
+        state_ = State::Done;
+        return true;
+    }
+    return state_ == State::Done;
+}
+
+size_t HttpResponseParser::feedHeaders(const char* data, size_t length) {
+    size_t consumed = 0;
+    while (consumed < length && state_ == State::Headers) {
+        const char* newline = static_cast<const char*>(
+            memchr(data + consumed, '\n', length - consumed));
+        size_t take = newline ? static_cast<size_t>(newline - (data + consumed)) + 1
+                              : length - consumed;
+
+        if (header_block_.size() + take > MAX_HEADER_SIZE) {
+            state_ = State::Error;
+            return consumed;
+        }
+        header_block_.append(data + consumed, take);
+        consumed += take;
+        if (!newline) break;
+
+        size_t line_length = header_block_.size() - line_start_;
+        line_start_ = header_block_.size();
+        if (line_length > 2 || (line_length == 2 && header_block_[line_start_ - 2] != '\r')) {
+            continue;
+        }
+
+        if (!parseHeaderBlock()) {
+            state_ = State::Error;
+        }
+    }
+    return consumed;
+}
+
+bool HttpResponseParser::parseHeaderBlock() {
+    HttpResponse response;
+    size_t line_end = header_block_.find('\n');
+    std::string status_line = header_block_.substr(0, line_end);
+
+    if (status_line.compare(0, 5, "HTTP/") != 0) return false;
+    size_t space = status_line.find(' ');
+    if (space == std::string::npos) return false;
+    response.status = atoi(status_line.c_str() + space + 1);
+    if (response.status < 100 || response.status > 999) return false;
+    bool http10 = status_line.compare(0, 8, "HTTP/1.0") == 0;
+
+    size_t begin = line_end + 1;
+    while (begin < header_block_.size()) {
+        size_t end = header_block_.find('\n', begin);
+        std::string line = header_block_.substr(begin, end - begin);
+        begin = end + 1;
+
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        response.headers.emplace_back(lowercase(trim(line.substr(0, colon))),
+                                      trim(line.substr(colon + 1)));
+    }
+
+    header_block_.clear();
+    line_start_ = 0;
+
+    // Interim responses (100 Continue and friends) precede the real one.
+    if (response.status < 200 && response.status != 101) {
+        return true;
+    }
+
+    const std::string& length = response.header("content-length");
+    if (!length.empty()) {
+        char* end = nullptr;
+        long long value = strtoll(length.c_str(), &end, 10);
+        if (end == length.c_str() || value < 0) return false;
+        response.content_length = value;
+    }
+    response.chunked =
+        lowercase(response.header("transfer-encoding")).find("chunked") != std::string::npos;
+
+    std::string connection = lowercase(response.header("connection"));
+    response.keep_alive = http10 ? connection == "keep-alive" : connection != "close";
+
+    response_ = std::move(response);
+
+    if (head_request_ || response_.status == 204 || response_.status == 304) {
+        state_ = State::Done;
+    } else if (response_.chunked) {
+        response_.content_length = -1;
+        state_ = State::Body;
+    } else if (response_.content_length >= 0) {
+        body_left_ = response_.content_length;
+        state_ = body_left_ == 0 ? State::Done : State::Body;
+    } else {
+        until_close_ = true;
+        response_.keep_alive = false;
+        state_ = State::Body;
+    }
+    return true;
+}
+
+size_t HttpResponseParser::feedChunked(const char* data, size_t length,
+                                       const char*& body, size_t& body_length) {
+    size_t i = 0;
+    while (i < length && state_ == State::Body) {
+        char c = data[i];
+        switch (chunk_state_) {
+            case ChunkState::Size:
+                if (isxdigit(static_cast<unsigned char>(c))) {
+                    if (chunk_size_ > (std::numeric_limits<int64_t>::max() >> 4)) {
+                        state_ = State::Error;
+                        return i;
+                    }
+                    int digit = isdigit(static_cast<unsigned char>(c)) ? c - '0'
+                                                                       : (tolower(c) - 'a' + 10);
+                    chunk_size_ = (chunk_size_ << 4) | digit;
+                    ++size_digits_;
+                } else if (size_digits_ > 0 && (c == ';' || c == ' ' || c == '\t')) {
+                    chunk_state_ = ChunkState::Extension;
+                } else if (size_digits_ > 0 && c == '\r') {
+                    chunk_state_ = ChunkState::SizeEnd;
+                } else if (size_digits_ > 0 && c == '\n') {
+                    chunk_state_ = ChunkState::SizeEnd;
+                    continue;
+                } else {
+                    state_ = State::Error;
+                    return i;
+                }
+                ++i;
+                break;
+            case ChunkState::Extension:
+                if (c == '\n') {
+                    chunk_state_ = ChunkState::SizeEnd;
+                    continue;
+                }
+                ++i;
+                break;
+            case ChunkState::SizeEnd:
+                if (c != '\n') {
+                    state_ = State::Error;
+                    return i;
+                }
+                ++i;
+                if (chunk_size_ == 0) {
+                    chunk_state_ = ChunkState::Trailer;
+                    trailer_line_empty_ = true;
+                } else {
+                    body_left_ = chunk_size_;
+                    chunk_state_ = ChunkState::Data;
+                }
+                chunk_size_ = 0;
+                size_digits_ = 0;
+                break;
+            case ChunkState::Data: {
+                size_t take = static_cast<size_t>(
+                    std::min<int64_t>(body_left_, static_cast<int64_t>(length - i)));
+                body_left_ -= take;
+                if (body_left_ == 0) chunk_state_ = ChunkState::DataCR;
+                body = data + i;
+                body_length = take;
+                return i + take;
+            }
+            case ChunkState::DataCR:
+                if (c == '\r') {
+                    chunk_state_ = ChunkState::DataLF;
+                } else if (c == '\n') {
+                    chunk_state_ = ChunkState::Size;
+                } else {
+                    state_ = State::Error;
+                    return i;
+                }
+                ++i;
+                break;
+            case ChunkState::DataLF:
+                if (c != '\n') {
+                    state_ = State::Error;
+                    return i;
+                }
+                chunk_state_ = ChunkState::Size;
+                ++i;
+                break;
+            case ChunkState::Trailer:
+                if (c == '\n') {
+                    if (trailer_line_empty_) {
+                        state_ = State::Done;
+                    }
+                    trailer_line_empty_ = true;
+                } else if (c != '\r') {
+                    trailer_line_empty_ = false;
+                }
+                ++i;
+                break;
+        }
+    }
+    return i;
+}
+
+}
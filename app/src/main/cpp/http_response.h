@@ -0,0 +1,80 @@
+#ifndef ORION_HTTP_RESPONSE_H
+#define ORION_HTTP_RESPONSE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace orion {
+
+struct HttpResponse {
+    int status = 0;
+    int64_t content_length = -1;
+    bool chunked = false;
+    bool keep_alive = false;
+    std::vector<std::pair<std::string, std::string>> headers;
+
+    // Header names are stored lowercased; returns "" when absent.
+    const std::string& header(const std::string& name) const;
+};
+
+// Incremental HTTP/1.1 response parser. Header bytes are buffered until the
+// blank line; body bytes are never copied, feed() hands back a span of the
+// caller's buffer instead. Handles Content-Length, chunked and read-until-close
+// bodies, and skips interim 1xx responses.
+class HttpResponseParser {
+public:
+    enum class State { Headers, Body, Done, Error };
+
+    HttpResponseParser();
+
+    void reset(bool head_request = false);
+
+    // Consumes a prefix of data and returns its length. When body bytes were
+    // found, body/body_length point at them inside data. Call repeatedly
+    // until all input is consumed or the state is Done/Error.
+    size_t feed(const char* data, size_t length, const char*& body, size_t& body_length);
+
+    // Signals that the peer closed the connection. Returns true when that
+    // legitimately ends the response (a body delimited by close).
+    bool finishOnClose();
+
+    State state() const { return state_; }
+    bool headersComplete() const { return state_ == State::Body || state_ == State::Done; }
+    bool done() const { return state_ == State::Done; }
+    bool failed() const { return state_ == State::Error; }
+
+    // Body bytes still expected, or -1 when the length is not known upfront.
+    int64_t remaining() const;
+
+    // Accounts for body bytes the caller took off the socket itself, as
+    // the splice path does. Only valid while remaining() is positive.
+    void skipBody(int64_t length);
+
+    const HttpResponse& response() const { return response_; }
+
+private:
+    enum class ChunkState { Size, Extension, SizeEnd, Data, DataCR, DataLF, Trailer };
+
+    size_t feedHeaders(const char* data, size_t length);
+    size_t feedChunked(const char* data, size_t length, const char*& body, size_t& body_length);
+    bool parseHeaderBlock();
+
+    State state_;
+    ChunkState chunk_state_;
+    HttpResponse response_;
+    std::string header_block_;
+    size_t line_start_;
+    int64_t body_left_;
+    int64_t chunk_size_;
+    int size_digits_;
+    bool head_request_;
+    bool until_close_;
+    bool trailer_line_empty_;
+};
+
+}
+
+#endif
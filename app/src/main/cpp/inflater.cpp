@@ -0,0 +1,100 @@
+#include "inflater.h"
+#include "log.h"
+#include <algorithm>
+#include <cstring>
+
+#define LOG_TAG "OrionInflater"
+#define LOGE(...) orion::logPrint(orion::LogLevel::Error, LOG_TAG, __VA_ARGS__)
+
+namespace orion {
+
+// 15-bit window; +32 detects a zlib or gzip header automatically.
+constexpr int AUTO_WINDOW_BITS = 15 + 32;
+constexpr int RAW_WINDOW_BITS = -15;
+
+static std::string lowercase(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+    return value;
+}
+
+Inflater::Inflater()
+    : initialized_(false)
+    , finished_(false)
+    , gzip_(false)
+    , try_raw_(false) {
+    memset(&stream_, 0, sizeof(stream_));
+}
+
+Inflater::~Inflater() {
+    if (initialized_) {
+        inflateEnd(&stream_);
+    }
+}
+
+bool Inflater::begin(const std::string& content_encoding) {
+    std::string encoding = lowercase(content_encoding);
+    if (encoding != "gzip" && encoding != "x-gzip" && encoding != "deflate") {
+        return false;
+    }
+    gzip_ = encoding != "deflate";
+    try_raw_ = !gzip_;
+    finished_ = false;
+
+    int result = initialized_ ? inflateReset2(&stream_, AUTO_WINDOW_BITS)
+                              : inflateInit2(&stream_, AUTO_WINDOW_BITS);
+    if (result != Z_OK) {
+        LOGE("inflate init failed: %d", result);
+        return false;
+    }
+    initialized_ = true;
+    if (!output_) {
+        output_.reset(new char[OUTPUT_SIZE]);
+    }
+    return true;
+}
+
+bool Inflater::decode(const char* data, size_t length, const InflateSink& sink) {
+    stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream_.avail_in = static_cast<uInt>(length);
+
+    while (stream_.avail_in > 0) {
+        if (finished_) {
+            // Concatenated gzip members decode as one body; anything after
+            // a deflate stream is ignored.
+            if (!gzip_) break;
+            if (inflateReset(&stream_) != Z_OK) return false;
+            finished_ = false;
+        }
+
+        stream_.next_out = reinterpret_cast<Bytef*>(output_.get());
+        stream_.avail_out = static_cast<uInt>(OUTPUT_SIZE);
+        bool fresh = stream_.total_in == 0 && stream_.total_out == 0;
+        int result = inflate(&stream_, Z_NO_FLUSH);
+
+        // Some servers send raw deflate where RFC 9110 asks for the zlib wrapper.
+        if (result == Z_DATA_ERROR && try_raw_ && fresh) {
+            if (inflateReset2(&stream_, RAW_WINDOW_BITS) != Z_OK) return false;
+            try_raw_ = false;
+            stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+            stream_.avail_in = static_cast<uInt>(length);
+            continue;
+        }
+        if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+            LOGE("inflate failed: %d (%s)", result, stream_.msg ? stream_.msg : "");
+            return false;
+        }
+
+        size_t produced = OUTPUT_SIZE - stream_.avail_out;
+        if (produced > 0 && !sink(output_.get(), produced)) {
+            return false;
+        }
+        if (result == Z_STREAM_END) {
+            finished_ = true;
+        } else if (produced == 0 && result == Z_BUF_ERROR) {
+            break;
+        }
+    }
+    return true;
+}
+
+}
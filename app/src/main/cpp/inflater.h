@@ -0,0 +1,44 @@
+#ifndef ORION_INFLATER_H
+#define ORION_INFLATER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <zlib.h>
+
+namespace orion {
+
+using InflateSink = std::function<bool(const char* data, size_t length)>;
+
+// Streaming gzip/deflate decoder for Content-Encoding bodies. The z_stream
+// and the output window are allocated once and reset between responses, so
+// a download inflates through the same fixed buffer however large it is.
+class Inflater {
+public:
+    static constexpr size_t OUTPUT_SIZE = 64 * 1024;
+
+    Inflater();
+    ~Inflater();
+
+    // Returns false for encodings other than gzip, x-gzip and deflate.
+    bool begin(const std::string& content_encoding);
+    // Inflates input, handing each filled window to sink. Returns false on
+    // corrupt input or when sink does.
+    bool decode(const char* data, size_t length, const InflateSink& sink);
+    // True once the final member's trailer has been checked.
+    bool finished() const { return finished_; }
+
+private:
+    z_stream stream_;
+    bool initialized_;
+    bool finished_;
+    bool gzip_;
+    bool try_raw_;
+    std::unique_ptr<char[]> output_;
+};
+
+}
+
+#endif
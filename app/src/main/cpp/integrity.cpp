@@ -0,0 +1,369 @@
+#include "integrity.h"
+#include "log.h"
+#include <zlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <iterator>
+
+#define LOG_TAG "OrionIntegrity"
+#define LOGD(...) orion::logPrint(orion::LogLevel::Debug, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) orion::logPrint(orion::LogLevel::Error, LOG_TAG, __VA_ARGS__)
+
+namespace orion {
+
+constexpr int64_t DEFAULT_PIECE_SIZE = 4 * 1024 * 1024;
+constexpr size_t READBACK_CHUNK = 256 * 1024;
+constexpr int64_t ADVANCE_CHUNK = 4 * READBACK_CHUNK;
+
+static std::string lowercase(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+    return value;
+}
+
+void IntegrityVerifier::Hasher::reset(HashAlgorithm hash_algorithm) {
+    algorithm = hash_algorithm;
+    crc = crc32(0L, Z_NULL, 0);
+    sha.reset();
+}
+
+void IntegrityVerifier::Hasher::update(const char* data, size_t length) {
+    if (algorithm == HashAlgorithm::Crc32) {
+        crc = crc32(crc, reinterpret_cast<const Bytef*>(data), static_cast<uInt>(length));
+    } else {
+        sha.update(data, length);
+    }
+}
+
+std::string IntegrityVerifier::Hasher::hexDigest() {
+    char hex[Sha256::DIGEST_SIZE * 2 + 1];
+    if (algorithm == HashAlgorithm::Crc32) {
+        snprintf(hex, sizeof(hex), "%08x", static_cast<unsigned>(crc));
+        return hex;
+    }
+    uint8_t digest[Sha256::DIGEST_SIZE];
+    sha.finish(digest);
+    for (size_t i = 0; i < Sha256::DIGEST_SIZE; ++i) {
+        snprintf(hex + i * 2, 3, "%02x", digest[i]);
+    }
+    return hex;
+}
+
+IntegrityVerifier::IntegrityVerifier()
+    : total_size_(-1)
+    , piece_size_(0)
+    , piece_count_(0)
+    , frontier_(0)
+    , advancing_(false)
+    , rewind_(false)
+    , advance_end_(0)
+    , checked_(false)
+    , verified_(false)
+    , corrupt_pieces_(0) {
+}
+
+void IntegrityVerifier::reset(const IntegrityOptions& options, int64_t total_size) {
+    options_ = options;
+    options_.expected_digest = lowercase(options_.expected_digest);
+    for (auto& digest : options_.piece_digests) {
+        digest = lowercase(digest);
+    }
+
+    total_size_ = total_size;
+    piece_size_ = 0;
+    piece_count_ = 0;
+    pieces_.reset();
+
+    bool manifest = options_.piece_size > 0 && !options_.piece_digests.empty();
+    if (manifest && total_size >= 0) {
+        int64_t expected = (total_size + options_.piece_size - 1) / options_.piece_size;
+        if (expected != static_cast<int64_t>(options_.piece_digests.size())) {
+            LOGE("Manifest lists %zu pieces, file has %lld; ignoring it",
+                 options_.piece_digests.size(), (long long)expected);
+            manifest = false;
+        }
+    }
+    if (!manifest) {
+        options_.piece_digests.clear();
+    }
+
+    if (active() && total_size > 0 &&
+        (manifest || options_.algorithm == HashAlgorithm::Crc32)) {
+        piece_size_ = manifest ? options_.piece_size : DEFAULT_PIECE_SIZE;
+        piece_count_ = (total_size + piece_size_ - 1) / piece_size_;
+        pieces_.reset(new Piece[piece_count_]);
+        for (int64_t i = 0; i < piece_count_; ++i) {
+            Piece& piece = pieces_[i];
+            piece.next = pieceStart(i);
+            piece.written = 0;
+            piece.in_order = true;
+            piece.attempts = 0;
+            piece.crc = 0;
+            piece.hasher.reset(options_.algorithm);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(frontier_mutex_);
+    frontier_ = 0;
+    frontier_hasher_.reset(options_.algorithm);
+    pending_.clear();
+    advancing_ = false;
+    rewind_ = false;
+    advance_end_ = 0;
+    digest_.clear();
+    checked_ = false;
+    verified_ = false;
+    corrupt_pieces_ = 0;
+}
+
+int64_t IntegrityVerifier::pieceLength(int64_t index) const {
+    return std::min(piece_size_, total_size_ - pieceStart(index));
+}
+
+bool IntegrityVerifier::update(int fd, int64_t offset, const char* data, size_t length,
+                               std::vector<std::pair<int64_t, int64_t>>& corrupt) {
+    if (!active() || length == 0) return true;
+
+    bool combined = options_.algorithm == HashAlgorithm::Crc32 && piece_count_ > 0;
+    if (!combined && !advanceFrontier(fd, offset, data, length)) {
+        return false;
+    }
+
+    int64_t end = offset + static_cast<int64_t>(length);
+    for (int64_t position = offset; position < end && piece_count_ > 0;) {
+        int64_t index = position / piece_size_;
+        Piece& piece = pieces_[index];
+        int64_t span = std::min(end, pieceStart(index) + pieceLength(index)) - position;
+
+        std::lock_guard<std::mutex> lock(piece.mutex);
+        if (piece.in_order && position == piece.next) {
+            piece.hasher.update(data + (position - offset), static_cast<size_t>(span));
+            piece.next += span;
+        } else {
+            piece.in_order = false;
+        }
+        piece.written += span;
+        if (piece.written == pieceLength(index) && !completePiece(fd, index, piece, corrupt)) {
+            return false;
+        }
+        position += span;
+    }
+    return true;
+}
+
+bool IntegrityVerifier::completePiece(int fd, int64_t index, Piece& piece,
+                                      std::vector<std::pair<int64_t, int64_t>>& corrupt) {
+    int64_t start = pieceStart(index);
+    int64_t length = pieceLength(index);
+    if (!piece.in_order) {
+        piece.hasher.reset(options_.algorithm);
+        if (!hashRange(fd, start, length, piece.hasher)) {
+            return false;
+        }
+    }
+    piece.crc = piece.hasher.crc;
+    std::string digest = piece.hasher.hexDigest();
+
+    if (options_.piece_digests.empty() || digest == options_.piece_digests[index]) {
+        return true;
+    }
+
+    LOGE("Piece %lld (%lld-%lld) failed verification", (long long)index,
+         (long long)start, (long long)(start + length - 1));
+    piece.next = start;
+    piece.written = 0;
+    piece.in_order = true;
+    piece.hasher.reset(options_.algorithm);
+    if (++piece.attempts >= MAX_PIECE_ATTEMPTS) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(frontier_mutex_);
+    corrupt_pieces_++;
+    rewindFrontierLocked(start, start + length);
+    corrupt.emplace_back(start, start + length - 1);
+    return true;
+}
+
+// Queues [offset, offset + length) and, unless another thread is at it,
+// moves the frontier over the queued ranges it now reaches. The caller's
+// bytes are hashed from its buffer; at most one ADVANCE_CHUNK is read back
+// per call, with the lock released, since callers include the event loop
+// and the write-behind thread. The rest waits for the next write, or for
+// finish().
+bool IntegrityVerifier::advanceFrontier(int fd, int64_t offset, const char* data, size_t length) {
+    std::unique_lock<std::mutex> lock(frontier_mutex_);
+    addPendingLocked(offset, offset + static_cast<int64_t>(length));
+    if (advancing_) return true;
+
+    advancing_ = true;
+    bool read_back = false;
+    while (!read_back && !pending_.empty() && pending_.begin()->first <= frontier_) {
+        auto first = pending_.begin();
+        if (first->second <= frontier_) {
+            pending_.erase(first);
+            continue;
+        }
+        int64_t from = frontier_;
+        advance_end_ = std::min(first->second, from + ADVANCE_CHUNK);
+        int64_t to = advance_end_;
+
+        lock.unlock();
+        bool hashed = hashFrontier(fd, from, to, offset, data, length, read_back);
+        lock.lock();
+
+        if (!hashed) {
+            advancing_ = false;
+            return false;
+        }
+        if (rewind_) {
+            // A piece in what was hashed failed; frontier_ is back at 0.
+            frontier_hasher_.reset(options_.algorithm);
+            rewind_ = false;
+        } else {
+            frontier_ = to;
+        }
+    }
+    advancing_ = false;
+    return true;
+}
+
+bool IntegrityVerifier::hashFrontier(int fd, int64_t from, int64_t to,
+                                     int64_t offset, const char* data, size_t length,
+                                     bool& read_back) {
+    int64_t data_end = offset + static_cast<int64_t>(length);
+    if (from < offset) {
+        int64_t stop = std::min(to, offset);
+        read_back = true;
+        if (!hashRange(fd, from, stop - from, frontier_hasher_)) return false;
+        from = stop;
+    }
+    if (from < to && from < data_end) {
+        int64_t stop = std::min(to, data_end);
+        frontier_hasher_.update(data + (from - offset), static_cast<size_t>(stop - from));
+        from = stop;
+    }
+    if (from >= to) return true;
+    read_back = true;
+    return hashRange(fd, from, to - from, frontier_hasher_);
+}
+
+void IntegrityVerifier::addPendingLocked(int64_t start, int64_t end) {
+    if (end <= frontier_) return;
+    auto next = pending_.upper_bound(start);
+    if (next != pending_.begin()) {
+        auto previous = std::prev(next);
+        if (previous->second >= start) {
+            start = previous->first;
+            end = std::max(end, previous->second);
+            pending_.erase(previous);
+        }
+    }
+    while (next != pending_.end() && next->first <= end) {
+        end = std::max(end, next->second);
+        next = pending_.erase(next);
+    }
+    pending_[start] = end;
+}
+
+// Drops the bad range from the queue. If the frontier hashed any of it,
+// everything it covered goes back on the queue and it restarts from 0.
+void IntegrityVerifier::rewindFrontierLocked(int64_t start, int64_t end) {
+    int64_t hashed = advancing_ ? advance_end_ : frontier_;
+    if (hashed > start) {
+        int64_t reached = frontier_;
+        frontier_ = 0;
+        addPendingLocked(0, reached);
+        if (advancing_) {
+            rewind_ = true;
+        } else {
+            frontier_hasher_.reset(options_.algorithm);
+        }
+    }
+
+    auto it = pending_.lower_bound(start);
+    if (it != pending_.begin() && std::prev(it)->second > start) {
+        --it;
+    }
+    while (it != pending_.end() && it->first < end) {
+        int64_t range_start = it->first;
+        int64_t range_end = it->second;
+        it = pending_.erase(it);
+        if (range_start < start) pending_[range_start] = start;
+        if (range_end > end) pending_[end] = range_end;
+    }
+}
+
+bool IntegrityVerifier::hashRange(int fd, int64_t offset, int64_t length, Hasher& hasher) {
+    std::vector<char> buffer(static_cast<size_t>(std::min<int64_t>(length, READBACK_CHUNK)));
+    while (length > 0) {
+        size_t wanted = static_cast<size_t>(std::min<int64_t>(length, buffer.size()));
+        ssize_t n = pread(fd, buffer.data(), wanted, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            LOGE("Readback failed at %lld", (long long)offset);
+            return false;
+        }
+        hasher.update(buffer.data(), static_cast<size_t>(n));
+        offset += n;
+        length -= n;
+    }
+    return true;
+}
+
+bool IntegrityVerifier::finish(int fd, int64_t total_size) {
+    if (!active()) return true;
+
+    std::string digest;
+    if (options_.algorithm == HashAlgorithm::Crc32 && piece_count_ > 0) {
+        uLong crc = crc32(0L, Z_NULL, 0);
+        for (int64_t i = 0; i < piece_count_; ++i) {
+            Piece& piece = pieces_[i];
+            std::lock_guard<std::mutex> lock(piece.mutex);
+            if (piece.written != pieceLength(i)) {
+                piece.hasher.reset(options_.algorithm);
+                if (!hashRange(fd, pieceStart(i), pieceLength(i), piece.hasher)) return false;
+                piece.crc = piece.hasher.crc;
+            }
+            crc = crc32_combine(crc, piece.crc, static_cast<z_off_t>(pieceLength(i)));
+        }
+        Hasher combined;
+        combined.reset(HashAlgorithm::Crc32);
+        combined.crc = static_cast<uint32_t>(crc);
+        digest = combined.hexDigest();
+    }
+
+    std::lock_guard<std::mutex> lock(frontier_mutex_);
+    pending_.clear();
+    if (digest.empty()) {
+        if (frontier_ < total_size) {
+            LOGD("Reading back %lld bytes for the whole-file digest",
+                 (long long)(total_size - frontier_));
+            if (!hashRange(fd, frontier_, total_size - frontier_, frontier_hasher_)) return false;
+            frontier_ = total_size;
+        }
+        digest = frontier_hasher_.hexDigest();
+    }
+
+    digest_ = digest;
+    checked_ = !options_.expected_digest.empty() || !options_.piece_digests.empty();
+    verified_ = options_.expected_digest.empty() || digest == options_.expected_digest;
+    if (!verified_) {
+        LOGE("File digest %s does not match expected %s", digest.c_str(),
+             options_.expected_digest.c_str());
+    }
+    return verified_;
+}
+
+IntegrityResult IntegrityVerifier::result() const {
+    std::lock_guard<std::mutex> lock(frontier_mutex_);
+    IntegrityResult result;
+    result.checked = checked_;
+    result.verified = verified_;
+    result.digest = digest_;
+    result.corrupt_pieces = corrupt_pieces_;
+    return result;
+}
+
+}
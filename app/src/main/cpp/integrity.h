@@ -0,0 +1,128 @@
+#ifndef ORION_INTEGRITY_H
+#define ORION_INTEGRITY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "sha256.h"
+
+namespace orion {
+
+enum class HashAlgorithm {
+    None = 0,
+    Crc32 = 1,
+    Sha256 = 2
+};
+
+struct IntegrityOptions {
+    HashAlgorithm algorithm = HashAlgorithm::None;
+    // Whole-file digest in hex; empty computes it without checking.
+    std::string expected_digest;
+    // Optional manifest: one hex digest per piece_size bytes of the file.
+    int64_t piece_size = 0;
+    std::vector<std::string> piece_digests;
+};
+
+struct IntegrityResult {
+    bool checked = false;
+    bool verified = false;
+    std::string digest;
+    int corrupt_pieces = 0;
+};
+
+// Hashes data on the receive path while it is still in cache. The file is
+// cut into fixed pieces (the manifest's, or 4 MiB for CRC32); a piece is
+// hashed inline as long as its bytes arrive in order and read back from
+// the page cache otherwise, which only happens where a segment was split.
+// A finished piece that contradicts the manifest is reported so the engine
+// can fetch that range again instead of the whole file.
+//
+// The whole-file CRC32 is combined from the piece CRCs. SHA-256 cannot be
+// combined, so the whole-file SHA-256 follows the in-order frontier: bytes
+// at the frontier are hashed inline, finished ranges ahead of it are queued,
+// and once a gap closes the writes that follow read the queued bytes back
+// a bounded chunk at a time, while they are still cached, rather than all
+// at the end.
+class IntegrityVerifier {
+public:
+    static constexpr int MAX_PIECE_ATTEMPTS = 3;
+
+    IntegrityVerifier();
+
+    // total_size is -1 for streamed bodies of unknown length.
+    void reset(const IntegrityOptions& options, int64_t total_size);
+    bool active() const { return options_.algorithm != HashAlgorithm::None; }
+
+    // Call after the bytes are on disk. Appends [first, last] ranges of
+    // pieces that failed their manifest digest; returns false once a piece
+    // has failed MAX_PIECE_ATTEMPTS times.
+    bool update(int fd, int64_t offset, const char* data, size_t length,
+                std::vector<std::pair<int64_t, int64_t>>& corrupt);
+    // Completes the whole-file digest; false if it contradicts the expected one.
+    bool finish(int fd, int64_t total_size);
+
+    IntegrityResult result() const;
+
+private:
+    struct Hasher {
+        HashAlgorithm algorithm;
+        uint32_t crc;
+        Sha256 sha;
+
+        void reset(HashAlgorithm algorithm);
+        void update(const char* data, size_t length);
+        std::string hexDigest();
+    };
+
+    struct Piece {
+        std::mutex mutex;
+        int64_t next;
+        int64_t written;
+        bool in_order;
+        int attempts;
+        uint32_t crc;
+        Hasher hasher;
+    };
+
+    bool completePiece(int fd, int64_t index, Piece& piece,
+                       std::vector<std::pair<int64_t, int64_t>>& corrupt);
+    bool hashRange(int fd, int64_t offset, int64_t length, Hasher& hasher);
+    bool advanceFrontier(int fd, int64_t offset, const char* data, size_t length);
+    bool hashFrontier(int fd, int64_t from, int64_t to,
+                      int64_t offset, const char* data, size_t length, bool& read_back);
+    void addPendingLocked(int64_t start, int64_t end);
+    void rewindFrontierLocked(int64_t start, int64_t end);
+    int64_t pieceStart(int64_t index) const { return index * piece_size_; }
+    int64_t pieceLength(int64_t index) const;
+
+    IntegrityOptions options_;
+    int64_t total_size_;
+    int64_t piece_size_;
+    int64_t piece_count_;
+    std::unique_ptr<Piece[]> pieces_;
+
+    mutable std::mutex frontier_mutex_;
+    int64_t frontier_;
+    Hasher frontier_hasher_;
+    // Written ranges ahead of the frontier, [start, end), merged.
+    std::map<int64_t, int64_t> pending_;
+    // One thread at a time owns frontier_hasher_ and hashes up to
+    // advance_end_ without the lock; a corrupt piece found meanwhile sets
+    // rewind_ for it to act on.
+    bool advancing_;
+    bool rewind_;
+    int64_t advance_end_;
+    std::string digest_;
+    bool checked_;
+    bool verified_;
+    int corrupt_pieces_;
+};
+
+}
+
+#endif
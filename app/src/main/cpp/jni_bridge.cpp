@@ -1,21 +1,167 @@
 #include <jni.h>
 #include <string>
 #include <memory>
-#include <map>
-#include <mutex>
 #include "download_engine.h"
+#include "download_manager.h"
+#include "progress_board.h"
+#include "handle_registry.h"
 
-static std::map<jlong, std::unique_ptr<orion::DownloadEngine>> engines;
-static std::mutex engines_mutex;
-static jlong next_engine_id = 1;
+static orion::HandleRegistry<orion::DownloadEngine> engines;
+static orion::HandleRegistry<orion::DownloadManager> managers;
 
 static JavaVM* g_jvm = nullptr;
 
+// Resolved once in JNI_OnLoad; FindClass from a native thread would only
+// see the system class loader anyway.
+static jclass g_progress_class = nullptr;
+static jmethodID g_progress_init = nullptr;
+static jclass g_resource_info_class = nullptr;
+static jmethodID g_resource_info_init = nullptr;
+static jclass g_integrity_class = nullptr;
+static jmethodID g_integrity_init = nullptr;
+static jclass g_result_class = nullptr;
+static jmethodID g_result_init = nullptr;
+static jclass g_stats_class = nullptr;
+static jmethodID g_stats_init = nullptr;
+static jclass g_connection_stats_class = nullptr;
+static jmethodID g_connection_stats_init = nullptr;
+static jmethodID g_engine_on_progress = nullptr;
+static jmethodID g_listener_on_progress = nullptr;
+static jmethodID g_listener_on_finished = nullptr;
+
+static jclass findGlobalClass(JNIEnv* env, const char* name) {
+    jclass local = env->FindClass(name);
+    if (!local) return nullptr;
+    jclass global = static_cast<jclass>(env->NewGlobalRef(local));
+    env->DeleteLocalRef(local);
+    return global;
+}
+
 extern "C" JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, void* reserved) {
     g_jvm = vm;
+
+    JNIEnv* env;
+    if (vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) != JNI_OK) {
+        return JNI_ERR;
+    }
+
+    g_progress_class = findGlobalClass(env, "com/orion/downloader/core/NativeDownloadEngine$DownloadProgress");
+    g_resource_info_class = findGlobalClass(env, "com/orion/downloader/core/NativeDownloadEngine$ResourceInfo");
+    g_integrity_class = findGlobalClass(env, "com/orion/downloader/core/NativeDownloadEngine$IntegrityResult");
+    g_result_class = findGlobalClass(env, "com/orion/downloader/core/NativeDownloadEngine$DownloadResult");
+    g_stats_class = findGlobalClass(env, "com/orion/downloader/core/NativeDownloadEngine$DownloadStats");
+    g_connection_stats_class = findGlobalClass(env, "com/orion/downloader/core/NativeDownloadEngine$ConnectionStats");
+    jclass callback_class = env->FindClass("com/orion/downloader/core/NativeDownloadEngine$ProgressCallback");
+    jclass listener_class = env->FindClass("com/orion/downloader/core/NativeDownloadManager$JobListener");
+    if (!g_progress_class || !g_resource_info_class || !g_integrity_class || !g_result_class ||
+        !g_stats_class || !g_connection_stats_class || !callback_class || !listener_class) {
+        return JNI_ERR;
+    }
+
+    g_progress_init = env->GetMethodID(g_progress_class, "<init>", "(JJDIJJ)V");
+    g_resource_info_init = env->GetMethodID(
+        g_resource_info_class, "<init>",
+        "(Ljava/lang/String;JZLjava/lang/String;Ljava/lang/String;Ljava/lang/String;)V");
+    g_integrity_init = env->GetMethodID(g_integrity_class, "<init>", "(ZZLjava/lang/String;I)V");
+    g_result_init = env->GetMethodID(g_result_class, "<init>", "(IIIIJ)V");
+    g_stats_init = env->GetMethodID(
+        g_stats_class, "<init>",
+        "(ZJ[Lcom/orion/downloader/core/NativeDownloadEngine$ConnectionStats;[J[JJJJ)V");
+    g_connection_stats_init = env->GetMethodID(g_connection_stats_class, "<init>", "(IJJJJJJJJJJJ)V");
+    g_engine_on_progress = env->GetMethodID(callback_class, "onProgress", "(JJDI)V");
+    g_listener_on_progress = env->GetMethodID(listener_class, "onProgress", "(JJDI)V");
+    g_listener_on_finished = env->GetMethodID(listener_class, "onFinished", "(JI)V");
+    env->DeleteLocalRef(callback_class);
+    env->DeleteLocalRef(listener_class);
     return JNI_VERSION_1_6;
 }
 
+// Attaches a native thread on its first callback and detaches it when the
+// thread exits, so the long-lived progress reporter attaches exactly once.
+static JNIEnv* currentEnv() {
+    struct Attachment {
+        JNIEnv* env = nullptr;
+        bool attached = false;
+        ~Attachment() {
+            if (attached && g_jvm) g_jvm->DetachCurrentThread();
+        }
+    };
+    thread_local Attachment attachment;
+
+    if (attachment.env || !g_jvm) return attachment.env;
+    if (g_jvm->GetEnv(reinterpret_cast<void**>(&attachment.env), JNI_VERSION_1_6) == JNI_OK) {
+        return attachment.env;
+    }
+    if (g_jvm->AttachCurrentThread(&attachment.env, nullptr) != JNI_OK) {
+        attachment.env = nullptr;
+        return nullptr;
+    }
+    attachment.attached = true;
+    return attachment.env;
+}
+
+// The global reference lives as long as the last callback holding it.
+static std::shared_ptr<_jobject> makeGlobalRef(JNIEnv* env, jobject object) {
+    return std::shared_ptr<_jobject>(env->NewGlobalRef(object), [](jobject ref) {
+        JNIEnv* env = currentEnv();
+        if (env) env->DeleteGlobalRef(ref);
+    });
+}
+
+static orion::ProgressCallback makeProgressCallback(JNIEnv* env, jobject callback,
+                                                    jmethodID method_id) {
+    std::shared_ptr<_jobject> global_callback = makeGlobalRef(env, callback);
+    
+    return [global_callback, method_id](const orion::DownloadProgress& progress) {
+        JNIEnv* env = currentEnv();
+        if (!env) return;
+        
+        env->CallVoidMethod(
+            global_callback.get(),
+            method_id,
+            static_cast<jlong>(progress.downloaded_bytes),
+            static_cast<jlong>(progress.total_bytes),
+            static_cast<jdouble>(progress.speed_bps),
+            static_cast<jint>(progress.active_connections)
+        );
+        if (env->ExceptionCheck()) {
+            env->ExceptionClear();
+        }
+    };
+}
+
+static orion::JobFinishedCallback makeFinishedCallback(JNIEnv* env, jobject listener) {
+    std::shared_ptr<_jobject> global_listener = makeGlobalRef(env, listener);
+    
+    return [global_listener](int64_t job_id, orion::JobState state) {
+        JNIEnv* env = currentEnv();
+        if (!env) return;
+        
+        env->CallVoidMethod(
+            global_listener.get(),
+            g_listener_on_finished,
+            static_cast<jlong>(job_id),
+            static_cast<jint>(state)
+        );
+        if (env->ExceptionCheck()) {
+            env->ExceptionClear();
+        }
+    };
+}
+
+static jobject newProgressObject(JNIEnv* env, const orion::DownloadProgress& progress) {
+    return env->NewObject(
+        g_progress_class,
+        g_progress_init,
+        static_cast<jlong>(progress.downloaded_bytes),
+        static_cast<jlong>(progress.total_bytes),
+        static_cast<jdouble>(progress.speed_bps),
+        static_cast<jint>(progress.active_connections),
+        static_cast<jlong>(progress.eta_seconds),
+        static_cast<jlong>(progress.decoded_bytes)
+    );
+}
+
 extern "C" JNIEXPORT jstring JNICALL
 Java_com_orion_downloader_core_DownloadEngine_nativeGetVersion(
     JNIEnv* env,
@@ -25,10 +171,7 @@ Java_com_orion_downloader_core_DownloadEngine_nativeGetVersion(
 
 extern "C" JNIEXPORT jlong JNICALL
 Java_com_orion_downloader_core_NativeDownloadEngine_nativeCreate(JNIEnv* env, jobject) {
-    std::lock_guard<std::mutex> lock(engines_mutex);
-    jlong engine_id = next_engine_id++;
-    engines[engine_id] = std::make_unique<orion::DownloadEngine>();
-    return engine_id;
+    return static_cast<jlong>(engines.add(std::make_shared<orion::DownloadEngine>()));
 }
 
 extern "C" JNIEXPORT void JNICALL
@@ -36,11 +179,11 @@ Java_com_orion_downloader_core_NativeDownloadEngine_nativeDestroy(
     JNIEnv* env,
     jobject,
     jlong engine_id) {
-    std::lock_guard<std::mutex> lock(engines_mutex);
-    auto it = engines.find(engine_id);
-    if (it != engines.end()) {
-        it->second->cancelDownload();
-        engines.erase(it);
+    // Calls still in flight hold their own reference; the engine is freed
+    // when the last of them returns.
+    std::shared_ptr<orion::DownloadEngine> engine = engines.remove(engine_id);
+    if (engine) {
+        engine->cancelDownload();
     }
 }
 
@@ -50,12 +193,11 @@ Java_com_orion_downloader_core_NativeDownloadEngine_nativeGetContentLength(
     jobject,
     jlong engine_id,
     jstring url) {
-    std::lock_guard<std::mutex> lock(engines_mutex);
-    auto it = engines.find(engine_id);
-    if (it == engines.end()) return -1;
+    std::shared_ptr<orion::DownloadEngine> engine = engines.find(engine_id);
+    if (!engine) return -1;
     
     const char* url_str = env->GetStringUTFChars(url, nullptr);
-    int64_t length = it->second->getContentLength(std::string(url_str));
+    int64_t length = engine->getContentLength(std::string(url_str));
     env->ReleaseStringUTFChars(url, url_str);
     
     return static_cast<jlong>(length);
@@ -67,17 +209,103 @@ Java_com_orion_downloader_core_NativeDownloadEngine_nativeSupportsRangeRequests(
     jobject,
     jlong engine_id,
     jstring url) {
-    std::lock_guard<std::mutex> lock(engines_mutex);
-    auto it = engines.find(engine_id);
-    if (it == engines.end()) return JNI_FALSE;
+    std::shared_ptr<orion::DownloadEngine> engine = engines.find(engine_id);
+    if (!engine) return JNI_FALSE;
     
     const char* url_str = env->GetStringUTFChars(url, nullptr);
-    bool supports = it->second->supportsRangeRequests(std::string(url_str));
+    bool supports = engine->supportsRangeRequests(std::string(url_str));
     env->ReleaseStringUTFChars(url, url_str);
     
     return supports ? JNI_TRUE : JNI_FALSE;
 }
 
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_orion_downloader_core_NativeDownloadEngine_nativeProbe(
+    JNIEnv* env,
+    jobject,
+    jlong engine_id,
+    jstring url) {
+    std::shared_ptr<orion::DownloadEngine> engine = engines.find(engine_id);
+    if (!engine) return nullptr;
+    
+    const char* url_str = env->GetStringUTFChars(url, nullptr);
+    orion::ResourceInfo info;
+    bool ok = engine->probe(std::string(url_str), info);
+    env->ReleaseStringUTFChars(url, url_str);
+    if (!ok) return nullptr;
+    
+    return env->NewObject(
+        g_resource_info_class,
+        g_resource_info_init,
+        env->NewStringUTF(info.final_url.c_str()),
+        static_cast<jlong>(info.content_length),
+        info.supports_ranges ? JNI_TRUE : JNI_FALSE,
+        env->NewStringUTF(info.etag.c_str()),
+        env->NewStringUTF(info.last_modified.c_str()),
+        env->NewStringUTF(info.content_type.c_str())
+    );
+}
+
+static std::string toString(JNIEnv* env, jstring value) {
+    if (!value) return std::string();
+    const char* chars = env->GetStringUTFChars(value, nullptr);
+    std::string result(chars);
+    env->ReleaseStringUTFChars(value, chars);
+    return result;
+}
+
+// Options shared by a fresh start and a journal resume, in the order both
+// native methods declare them.
+static orion::DownloadOptions readOptions(
+    JNIEnv* env,
+    jint num_connections,
+    jint io_backend,
+    jboolean pipeline_requests,
+    jlong rate_limit,
+    jboolean decompress,
+    jboolean collect_stats,
+    jint write_behind_buffers,
+    jlong write_sync_bytes,
+    jobjectArray mirrors,
+    jlong endgame_bytes,
+    jstring delta_manifest_url,
+    jstring local_etag,
+    jstring local_last_modified,
+    jint hash_algorithm,
+    jstring expected_digest,
+    jlong piece_size,
+    jobjectArray piece_digests) {
+    orion::DownloadOptions options;
+    options.num_connections = static_cast<int>(num_connections);
+    options.io_backend = static_cast<orion::IoBackend>(io_backend);
+    options.pipeline_requests = pipeline_requests == JNI_TRUE;
+    options.rate_limit = static_cast<int64_t>(rate_limit);
+    options.decompress = decompress == JNI_TRUE;
+    options.collect_stats = collect_stats == JNI_TRUE;
+    options.write_behind_buffers = static_cast<int>(write_behind_buffers);
+    options.write_sync_bytes = static_cast<int64_t>(write_sync_bytes);
+    options.endgame_bytes = static_cast<int64_t>(endgame_bytes);
+    jsize mirror_count = mirrors ? env->GetArrayLength(mirrors) : 0;
+    for (jsize i = 0; i < mirror_count; ++i) {
+        jstring mirror = static_cast<jstring>(env->GetObjectArrayElement(mirrors, i));
+        options.mirrors.push_back(toString(env, mirror));
+        env->DeleteLocalRef(mirror);
+    }
+    options.delta_manifest_url = toString(env, delta_manifest_url);
+    options.local_etag = toString(env, local_etag);
+    options.local_last_modified = toString(env, local_last_modified);
+    options.integrity.algorithm = static_cast<orion::HashAlgorithm>(hash_algorithm);
+    options.integrity.expected_digest = toString(env, expected_digest);
+    options.integrity.piece_size = static_cast<int64_t>(piece_size);
+    jsize piece_count = piece_digests ? env->GetArrayLength(piece_digests) : 0;
+    for (jsize i = 0; i < piece_count; ++i) {
+        jstring digest = static_cast<jstring>(env->GetObjectArrayElement(piece_digests, i));
+        options.integrity.piece_digests.push_back(toString(env, digest));
+        env->DeleteLocalRef(digest);
+    }
+    return options;
+}
+
 extern "C" JNIEXPORT jboolean JNICALL
 Java_com_orion_downloader_core_NativeDownloadEngine_nativeStartDownload(
     JNIEnv* env,
@@ -86,51 +314,42 @@ Java_com_orion_downloader_core_NativeDownloadEngine_nativeStartDownload(
     jstring url,
     jstring output_path,
     jint num_connections,
+    jint io_backend,
+    jboolean pipeline_requests,
+    jlong rate_limit,
+    jboolean decompress,
+    jboolean collect_stats,
+    jint write_behind_buffers,
+    jlong write_sync_bytes,
+    jobjectArray mirrors,
+    jlong endgame_bytes,
+    jstring delta_manifest_url,
+    jstring local_etag,
+    jstring local_last_modified,
+    jint hash_algorithm,
+    jstring expected_digest,
+    jlong piece_size,
+    jobjectArray piece_digests,
     jobject callback) {
     
-    std::lock_guard<std::mutex> lock(engines_mutex);
-    auto it = engines.find(engine_id);
-    if (it == engines.end()) return JNI_FALSE;
+    std::shared_ptr<orion::DownloadEngine> engine = engines.find(engine_id);
+    if (!engine) return JNI_FALSE;
     
     const char* url_str = env->GetStringUTFChars(url, nullptr);
     const char* path_str = env->GetStringUTFChars(output_path, nullptr);
     
-    jobject global_callback = env->NewGlobalRef(callback);
-    jclass callback_class = env->GetObjectClass(global_callback);
-    jmethodID method_id = env->GetMethodID(callback_class, "onProgress", "(JJDI)V");
+    auto progress_callback = makeProgressCallback(env, callback, g_engine_on_progress);
     
-    auto progress_callback = [global_callback, method_id](orion::DownloadProgress progress) {
-        if (!g_jvm) return;
-        
-        JNIEnv* env;
-        bool should_detach = false;
-        
-        if (g_jvm->GetEnv((void**)&env, JNI_VERSION_1_6) != JNI_OK) {
-            if (g_jvm->AttachCurrentThread(&env, nullptr) == JNI_OK) {
-                should_detach = true;
-            } else {
-                return;
-            }
-        }
-        
-        env->CallVoidMethod(
-            global_callback,
-            method_id,
-            static_cast<jlong>(progress.downloaded_bytes),
-            static_cast<jlong>(progress.total_bytes),
-            static_cast<jdouble>(progress.speed_bps),
-            static_cast<jint>(progress.active_connections)
-        );
-        
-        if (should_detach) {
-            g_jvm->DetachCurrentThread();
-        }
-    };
+    orion::DownloadOptions options = readOptions(
+        env, num_connections, io_backend, pipeline_requests, rate_limit, decompress,
+        collect_stats, write_behind_buffers, write_sync_bytes, mirrors, endgame_bytes,
+        delta_manifest_url, local_etag, local_last_modified, hash_algorithm, expected_digest,
+        piece_size, piece_digests);
     
-    bool result = it->second->startDownload(
+    bool result = engine->startDownload(
         std::string(url_str),
         std::string(path_str),
-        static_cast<int>(num_connections),
+        options,
         progress_callback
     );
     
@@ -140,15 +359,63 @@ Java_com_orion_downloader_core_NativeDownloadEngine_nativeStartDownload(
     return result ? JNI_TRUE : JNI_FALSE;
 }
 
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_orion_downloader_core_NativeDownloadEngine_nativeResumeFromJournal(
+    JNIEnv* env,
+    jobject thiz,
+    jlong engine_id,
+    jstring output_path,
+    jint num_connections,
+    jint io_backend,
+    jboolean pipeline_requests,
+    jlong rate_limit,
+    jboolean decompress,
+    jboolean collect_stats,
+    jint write_behind_buffers,
+    jlong write_sync_bytes,
+    jobjectArray mirrors,
+    jlong endgame_bytes,
+    jstring delta_manifest_url,
+    jstring local_etag,
+    jstring local_last_modified,
+    jint hash_algorithm,
+    jstring expected_digest,
+    jlong piece_size,
+    jobjectArray piece_digests,
+    jobject callback) {
+    
+    std::shared_ptr<orion::DownloadEngine> engine = engines.find(engine_id);
+    if (!engine) return JNI_FALSE;
+    
+    const char* path_str = env->GetStringUTFChars(output_path, nullptr);
+    
+    auto progress_callback = makeProgressCallback(env, callback, g_engine_on_progress);
+    
+    orion::DownloadOptions options = readOptions(
+        env, num_connections, io_backend, pipeline_requests, rate_limit, decompress,
+        collect_stats, write_behind_buffers, write_sync_bytes, mirrors, endgame_bytes,
+        delta_manifest_url, local_etag, local_last_modified, hash_algorithm, expected_digest,
+        piece_size, piece_digests);
+    
+    bool result = engine->resumeFromJournal(
+        std::string(path_str),
+        options,
+        progress_callback
+    );
+    
+    env->ReleaseStringUTFChars(output_path, path_str);
+    
+    return result ? JNI_TRUE : JNI_FALSE;
+}
+
 extern "C" JNIEXPORT void JNICALL
 Java_com_orion_downloader_core_NativeDownloadEngine_nativePauseDownload(
     JNIEnv* env,
     jobject,
     jlong engine_id) {
-    std::lock_guard<std::mutex> lock(engines_mutex);
-    auto it = engines.find(engine_id);
-    if (it != engines.end()) {
-        it->second->pauseDownload();
+    std::shared_ptr<orion::DownloadEngine> engine = engines.find(engine_id);
+    if (engine) {
+        engine->pauseDownload();
     }
 }
 
@@ -157,10 +424,9 @@ Java_com_orion_downloader_core_NativeDownloadEngine_nativeResumeDownload(
     JNIEnv* env,
     jobject,
     jlong engine_id) {
-    std::lock_guard<std::mutex> lock(engines_mutex);
-    auto it = engines.find(engine_id);
-    if (it != engines.end()) {
-        it->second->resumeDownload();
+    std::shared_ptr<orion::DownloadEngine> engine = engines.find(engine_id);
+    if (engine) {
+        engine->resumeDownload();
     }
 }
 
@@ -169,22 +435,50 @@ Java_com_orion_downloader_core_NativeDownloadEngine_nativeCancelDownload(
     JNIEnv* env,
     jobject,
     jlong engine_id) {
-    std::lock_guard<std::mutex> lock(engines_mutex);
-    auto it = engines.find(engine_id);
-    if (it != engines.end()) {
-        it->second->cancelDownload();
+    std::shared_ptr<orion::DownloadEngine> engine = engines.find(engine_id);
+    if (engine) {
+        engine->cancelDownload();
     }
 }
 
+extern "C" JNIEXPORT void JNICALL
+Java_com_orion_downloader_core_NativeDownloadEngine_nativeSetRateLimit(
+    JNIEnv* env,
+    jobject,
+    jlong engine_id,
+    jlong bytes_per_second) {
+    std::shared_ptr<orion::DownloadEngine> engine = engines.find(engine_id);
+    if (engine) {
+        engine->setRateLimit(static_cast<int64_t>(bytes_per_second));
+    }
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_orion_downloader_core_NativeDownloadEngine_nativeSetGlobalRateLimit(
+    JNIEnv* env,
+    jclass,
+    jlong bytes_per_second) {
+    orion::DownloadEngine::setGlobalRateLimit(static_cast<int64_t>(bytes_per_second));
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_orion_downloader_core_NativeDownloadEngine_nativeProgressHandle(
+    JNIEnv* env,
+    jobject,
+    jlong engine_id) {
+    std::shared_ptr<orion::DownloadEngine> engine = engines.find(engine_id);
+    if (!engine) return -1;
+    return static_cast<jlong>(engine->progressHandle());
+}
+
 extern "C" JNIEXPORT jboolean JNICALL
 Java_com_orion_downloader_core_NativeDownloadEngine_nativeIsDownloading(
     JNIEnv* env,
     jobject,
     jlong engine_id) {
-    std::lock_guard<std::mutex> lock(engines_mutex);
-    auto it = engines.find(engine_id);
-    if (it == engines.end()) return JNI_FALSE;
-    return it->second->isDownloading() ? JNI_TRUE : JNI_FALSE;
+    std::shared_ptr<orion::DownloadEngine> engine = engines.find(engine_id);
+    if (!engine) return JNI_FALSE;
+    return engine->isDownloading() ? JNI_TRUE : JNI_FALSE;
 }
 
 extern "C" JNIEXPORT jboolean JNICALL
@@ -192,10 +486,9 @@ Java_com_orion_downloader_core_NativeDownloadEngine_nativeIsPaused(
     JNIEnv* env,
     jobject,
     jlong engine_id) {
-    std::lock_guard<std::mutex> lock(engines_mutex);
-    auto it = engines.find(engine_id);
-    if (it == engines.end()) return JNI_FALSE;
-    return it->second->isPaused() ? JNI_TRUE : JNI_FALSE;
+    std::shared_ptr<orion::DownloadEngine> engine = engines.find(engine_id);
+    if (!engine) return JNI_FALSE;
+    return engine->isPaused() ? JNI_TRUE : JNI_FALSE;
 }
 
 extern "C" JNIEXPORT jobject JNICALL
@@ -203,21 +496,270 @@ Java_com_orion_downloader_core_NativeDownloadEngine_nativeGetProgress(
     JNIEnv* env,
     jobject,
     jlong engine_id) {
-    std::lock_guard<std::mutex> lock(engines_mutex);
-    auto it = engines.find(engine_id);
-    if (it == engines.end()) return nullptr;
+    std::shared_ptr<orion::DownloadEngine> engine = engines.find(engine_id);
+    if (!engine) return nullptr;
     
-    orion::DownloadProgress progress = it->second->getProgress();
+    orion::DownloadProgress progress = engine->getProgress();
     
-    jclass progress_class = env->FindClass("com/orion/downloader/core/NativeDownloadEngine$DownloadProgress");
-    jmethodID constructor = env->GetMethodID(progress_class, "<init>", "(JJDI)V");
+    return newProgressObject(env, progress);
+}
+
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_orion_downloader_core_NativeDownloadEngine_nativeGetIntegrity(
+    JNIEnv* env,
+    jobject,
+    jlong engine_id) {
+    std::shared_ptr<orion::DownloadEngine> engine = engines.find(engine_id);
+    if (!engine) return nullptr;
+    
+    orion::IntegrityResult result = engine->getIntegrity();
     
     return env->NewObject(
-        progress_class,
-        constructor,
-        static_cast<jlong>(progress.downloaded_bytes),
-        static_cast<jlong>(progress.total_bytes),
-        static_cast<jdouble>(progress.speed_bps),
-        static_cast<jint>(progress.active_connections)
+        g_integrity_class,
+        g_integrity_init,
+        result.checked ? JNI_TRUE : JNI_FALSE,
+        result.verified ? JNI_TRUE : JNI_FALSE,
+        env->NewStringUTF(result.digest.c_str()),
+        static_cast<jint>(result.corrupt_pieces)
+    );
+}
+
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_orion_downloader_core_NativeDownloadEngine_nativeGetResult(
+    JNIEnv* env,
+    jobject,
+    jlong engine_id) {
+    std::shared_ptr<orion::DownloadEngine> engine = engines.find(engine_id);
+    if (!engine) return nullptr;
+    
+    orion::DownloadResult result = engine->getResult();
+    
+    return env->NewObject(
+        g_result_class,
+        g_result_init,
+        static_cast<jint>(result.outcome),
+        static_cast<jint>(result.reason),
+        static_cast<jint>(result.http_status),
+        static_cast<jint>(result.retries),
+        static_cast<jlong>(result.reused_bytes)
+    );
+}
+
+static jlongArray newLongArray(JNIEnv* env, const std::vector<uint64_t>& values) {
+    jlongArray array = env->NewLongArray(static_cast<jsize>(values.size()));
+    std::vector<jlong> copy(values.begin(), values.end());
+    env->SetLongArrayRegion(array, 0, static_cast<jsize>(copy.size()), copy.data());
+    return array;
+}
+
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_orion_downloader_core_NativeDownloadEngine_nativeGetStats(
+    JNIEnv* env,
+    jobject,
+    jlong engine_id) {
+    std::shared_ptr<orion::DownloadEngine> engine = engines.find(engine_id);
+    if (!engine) return nullptr;
+    
+    orion::DownloadStats stats = engine->getStats();
+    
+    jobjectArray connections = env->NewObjectArray(
+        static_cast<jsize>(stats.connections.size()), g_connection_stats_class, nullptr);
+    for (size_t i = 0; i < stats.connections.size(); ++i) {
+        const orion::ConnectionStats& entry = stats.connections[i];
+        jobject item = env->NewObject(
+            g_connection_stats_class,
+            g_connection_stats_init,
+            static_cast<jint>(entry.connection_id),
+            static_cast<jlong>(entry.resolve_us),
+            static_cast<jlong>(entry.connect_us),
+            static_cast<jlong>(entry.connects),
+            static_cast<jlong>(entry.first_byte_us),
+            static_cast<jlong>(entry.requests),
+            static_cast<jlong>(entry.response_wait_us),
+            static_cast<jlong>(entry.bytes),
+            static_cast<jlong>(entry.recv_wait_us),
+            static_cast<jlong>(entry.stall_us),
+            static_cast<jlong>(entry.throttle_us),
+            static_cast<jlong>(entry.write_us)
+        );
+        env->SetObjectArrayElement(connections, static_cast<jsize>(i), item);
+        env->DeleteLocalRef(item);
+    }
+    
+    return env->NewObject(
+        g_stats_class,
+        g_stats_init,
+        stats.enabled ? JNI_TRUE : JNI_FALSE,
+        static_cast<jlong>(stats.resolve_us),
+        connections,
+        newLongArray(env, stats.recv_size_histogram),
+        newLongArray(env, stats.write_latency_histogram),
+        static_cast<jlong>(stats.hedges),
+        static_cast<jlong>(stats.hedges_won),
+        static_cast<jlong>(stats.hedge_wasted_bytes)
+    );
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_orion_downloader_core_NativeDownloadManager_nativeCreate(
+    JNIEnv* env,
+    jobject,
+    jint max_connections,
+    jint max_connections_per_host) {
+    return static_cast<jlong>(managers.add(std::make_shared<orion::DownloadManager>(
+        static_cast<int>(max_connections),
+        static_cast<int>(max_connections_per_host)
+    )));
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_orion_downloader_core_NativeDownloadManager_nativeDestroy(
+    JNIEnv* env,
+    jobject,
+    jlong manager_id) {
+    managers.remove(manager_id);
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_orion_downloader_core_NativeDownloadManager_nativeSubmit(
+    JNIEnv* env,
+    jobject,
+    jlong manager_id,
+    jstring url,
+    jstring output_path,
+    jint priority,
+    jint num_connections,
+    jobject listener) {
+    
+    std::shared_ptr<orion::DownloadManager> manager = managers.find(manager_id);
+    if (!manager) return -1;
+    
+    const char* url_str = env->GetStringUTFChars(url, nullptr);
+    const char* path_str = env->GetStringUTFChars(output_path, nullptr);
+    
+    int64_t job_id = manager->submit(
+        std::string(url_str),
+        std::string(path_str),
+        static_cast<int>(priority),
+        static_cast<int>(num_connections),
+        makeProgressCallback(env, listener, g_listener_on_progress),
+        makeFinishedCallback(env, listener)
     );
+    
+    env->ReleaseStringUTFChars(url, url_str);
+    env->ReleaseStringUTFChars(output_path, path_str);
+    
+    return static_cast<jlong>(job_id);
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_orion_downloader_core_NativeDownloadManager_nativeCancel(
+    JNIEnv* env,
+    jobject,
+    jlong manager_id,
+    jlong job_id) {
+    std::shared_ptr<orion::DownloadManager> manager = managers.find(manager_id);
+    if (!manager) return JNI_FALSE;
+    return manager->cancel(job_id) ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_orion_downloader_core_NativeDownloadManager_nativePause(
+    JNIEnv* env,
+    jobject,
+    jlong manager_id,
+    jlong job_id) {
+    std::shared_ptr<orion::DownloadManager> manager = managers.find(manager_id);
+    if (!manager) return JNI_FALSE;
+    return manager->pause(job_id) ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_orion_downloader_core_NativeDownloadManager_nativeResume(
+    JNIEnv* env,
+    jobject,
+    jlong manager_id,
+    jlong job_id) {
+    std::shared_ptr<orion::DownloadManager> manager = managers.find(manager_id);
+    if (!manager) return JNI_FALSE;
+    return manager->resume(job_id) ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_orion_downloader_core_NativeDownloadManager_nativeSetPriority(
+    JNIEnv* env,
+    jobject,
+    jlong manager_id,
+    jlong job_id,
+    jint priority) {
+    std::shared_ptr<orion::DownloadManager> manager = managers.find(manager_id);
+    if (!manager) return JNI_FALSE;
+    return manager->setPriority(job_id, static_cast<int>(priority)) ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_orion_downloader_core_NativeDownloadManager_nativeSetRateLimit(
+    JNIEnv* env,
+    jobject,
+    jlong manager_id,
+    jlong job_id,
+    jlong bytes_per_second) {
+    std::shared_ptr<orion::DownloadManager> manager = managers.find(manager_id);
+    if (!manager) return JNI_FALSE;
+    return manager->setRateLimit(job_id, static_cast<int64_t>(bytes_per_second)) ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_orion_downloader_core_NativeDownloadManager_nativeRelease(
+    JNIEnv* env,
+    jobject,
+    jlong manager_id,
+    jlong job_id) {
+    std::shared_ptr<orion::DownloadManager> manager = managers.find(manager_id);
+    if (manager) {
+        manager->release(job_id);
+    }
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_orion_downloader_core_NativeDownloadManager_nativeGetState(
+    JNIEnv* env,
+    jobject,
+    jlong manager_id,
+    jlong job_id) {
+    std::shared_ptr<orion::DownloadManager> manager = managers.find(manager_id);
+    if (!manager) return static_cast<jint>(orion::JobState::Unknown);
+    return static_cast<jint>(manager->getState(job_id));
+}
+
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_orion_downloader_core_NativeDownloadManager_nativeGetProgress(
+    JNIEnv* env,
+    jobject,
+    jlong manager_id,
+    jlong job_id) {
+    std::shared_ptr<orion::DownloadManager> manager = managers.find(manager_id);
+    if (!manager) return nullptr;
+    
+    orion::DownloadProgress progress;
+    if (!manager->getProgress(job_id, progress)) return nullptr;
+    
+    return newProgressObject(env, progress);
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_orion_downloader_core_NativeDownloadManager_nativeProgressHandle(
+    JNIEnv* env,
+    jobject,
+    jlong manager_id,
+    jlong job_id) {
+    std::shared_ptr<orion::DownloadManager> manager = managers.find(manager_id);
+    if (!manager) return -1;
+    return static_cast<jlong>(manager->progressHandle(job_id));
+}
+
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_orion_downloader_core_NativeProgressBoard_nativeBoard(JNIEnv* env, jclass) {
+    orion::ProgressBoard& board = orion::ProgressBoard::shared();
+    return env->NewDirectByteBuffer(board.data(), static_cast<jlong>(board.size()));
 }
@@ -0,0 +1,37 @@
+#include "log.h"
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#ifdef __ANDROID__
+#include <android/log.h>
+#endif
+
+namespace orion {
+
+constexpr size_t MAX_MESSAGE = 1024;
+
+static void defaultSink(LogLevel level, const char* tag, const char* message) {
+#ifdef __ANDROID__
+    __android_log_write(static_cast<int>(level), tag, message);
+#else
+    static const char LEVELS[] = "??VDIWE";
+    fprintf(stderr, "%c/%s: %s\n", LEVELS[static_cast<int>(level)], tag, message);
+#endif
+}
+
+static std::atomic<LogSink> sink_{defaultSink};
+
+void setLogSink(LogSink sink) {
+    sink_.store(sink ? sink : defaultSink);
+}
+
+void logPrint(LogLevel level, const char* tag, const char* format, ...) {
+    char message[MAX_MESSAGE];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    sink_.load(std::memory_order_relaxed)(level, tag, message);
+}
+
+}
@@ -0,0 +1,25 @@
+#ifndef ORION_LOG_H
+#define ORION_LOG_H
+
+namespace orion {
+
+// Values match android_LogPriority so the default sink passes them through.
+enum class LogLevel {
+    Debug = 3,
+    Info = 4,
+    Warn = 5,
+    Error = 6
+};
+
+using LogSink = void (*)(LogLevel level, const char* tag, const char* message);
+
+// Routes engine logging; nullptr restores the default, which is logcat on
+// Android and stderr elsewhere. Sinks may be called from any thread.
+void setLogSink(LogSink sink);
+
+void logPrint(LogLevel level, const char* tag, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+}
+
+#endif
@@ -0,0 +1,67 @@
+#include "metadata_cache.h"
+#include <chrono>
+
+namespace orion {
+
+constexpr size_t MAX_ENTRIES = 64;
+constexpr int64_t ENTRY_TTL_MS = 5 * 60 * 1000;
+
+static int64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+MetadataCache& MetadataCache::shared() {
+    static MetadataCache instance;
+    return instance;
+}
+
+bool MetadataCache::lookup(const std::string& url, ResourceInfo& info) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(url);
+    if (it == index_.end()) return false;
+
+    if (nowMs() - it->second->stored_ms > ENTRY_TTL_MS) {
+        entries_.erase(it->second);
+        index_.erase(it);
+        return false;
+    }
+
+    entries_.splice(entries_.begin(), entries_, it->second);
+    info = it->second->info;
+    return true;
+}
+
+void MetadataCache::store(const std::string& url, const ResourceInfo& info) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(url);
+    if (it != index_.end()) {
+        entries_.erase(it->second);
+        index_.erase(it);
+    }
+
+    entries_.push_front({url, info, nowMs()});
+    index_[url] = entries_.begin();
+
+    if (entries_.size() > MAX_ENTRIES) {
+        index_.erase(entries_.back().url);
+        entries_.pop_back();
+    }
+}
+
+void MetadataCache::invalidate(const std::string& url) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(url);
+    if (it != index_.end()) {
+        entries_.erase(it->second);
+        index_.erase(it);
+    }
+}
+
+void MetadataCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    index_.clear();
+}
+
+}
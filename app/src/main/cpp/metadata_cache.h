@@ -0,0 +1,47 @@
+#ifndef ORION_METADATA_CACHE_H
+#define ORION_METADATA_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace orion {
+
+struct ResourceInfo {
+    std::string final_url;
+    int64_t content_length = -1;
+    bool supports_ranges = false;
+    std::string etag;
+    std::string last_modified;
+    std::string content_type;
+};
+
+// Process-wide LRU of probe results keyed by the requested URL, so retrying
+// or re-adding a download skips the round trip. Entries expire after a few
+// minutes and are dropped as soon as a response contradicts their validators.
+class MetadataCache {
+public:
+    static MetadataCache& shared();
+
+    bool lookup(const std::string& url, ResourceInfo& info);
+    void store(const std::string& url, const ResourceInfo& info);
+    void invalidate(const std::string& url);
+    void clear();
+
+private:
+    struct Entry {
+        std::string url;
+        ResourceInfo info;
+        int64_t stored_ms;
+    };
+
+    std::mutex mutex_;
+    std::list<Entry> entries_;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+};
+
+}
+
+#endif
@@ -0,0 +1,148 @@
+#include "mirror_set.h"
+#include "log.h"
+#include <algorithm>
+
+#define LOG_TAG "OrionMirrors"
+#define LOGI(...) orion::logPrint(orion::LogLevel::Info, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) orion::logPrint(orion::LogLevel::Error, LOG_TAG, __VA_ARGS__)
+
+namespace orion {
+
+// A connection only moves when the other mirror would be this much less
+// loaded, so keep-alive sockets are not thrown away over measurement noise.
+constexpr double SWITCH_RATIO = 0.75;
+constexpr double RATE_WEIGHT = 0.3;
+
+void MirrorSet::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+}
+
+void MirrorSet::add(const Mirror& mirror) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry entry;
+    entry.mirror = mirror;
+    entries_.push_back(std::move(entry));
+}
+
+// Connections per unit of rate once one more joins. Unmeasured mirrors
+// borrow the average so they get a fair first share.
+double MirrorSet::loadAfterJoining(const Entry& entry, double fallback_rate) const {
+    double rate = entry.rate > 0.0 ? entry.rate : fallback_rate;
+    return (entry.connections + 1) / rate;
+}
+
+int MirrorSet::assign(int current) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    double total = 0.0;
+    int measured = 0;
+    for (const Entry& entry : entries_) {
+        if (entry.live && entry.rate > 0.0) {
+            total += entry.rate;
+            ++measured;
+        }
+    }
+    double fallback_rate = measured > 0 ? total / measured : 1.0;
+
+    int best = -1;
+    double best_load = 0.0;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        const Entry& entry = entries_[i];
+        if (!entry.live || static_cast<int>(i) == current) continue;
+        double load = loadAfterJoining(entry, fallback_rate);
+        if (best < 0 || load < best_load) {
+            best = static_cast<int>(i);
+            best_load = load;
+        }
+    }
+
+    if (current >= 0) {
+        Entry& entry = entries_[current];
+        if (entry.live) {
+            double rate = entry.rate > 0.0 ? entry.rate : fallback_rate;
+            if (best < 0 || best_load >= entry.connections / rate * SWITCH_RATIO) {
+                return current;
+            }
+        }
+        --entry.connections;
+    }
+    if (best >= 0) {
+        ++entries_[best].connections;
+    }
+    return best;
+}
+
+void MirrorSet::join(int index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++entries_[index].connections;
+}
+
+void MirrorSet::leave(int index) {
+    if (index < 0) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    --entries_[index].connections;
+}
+
+void MirrorSet::recordSuccess(int index, int64_t bytes, int64_t elapsed_ms) {
+    if (index < 0 || bytes <= 0) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& entry = entries_[index];
+    entry.failures = 0;
+    entry.bytes += bytes;
+    double sample = static_cast<double>(bytes) / std::max<int64_t>(elapsed_ms, 1);
+    entry.rate = entry.rate > 0.0 ? entry.rate + RATE_WEIGHT * (sample - entry.rate) : sample;
+}
+
+bool MirrorSet::recordFailure(int index) {
+    if (index < 0) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& entry = entries_[index];
+    return ++entry.failures >= MAX_FAILURES && dropLocked(index);
+}
+
+bool MirrorSet::drop(int index) {
+    if (index < 0) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropLocked(index);
+}
+
+bool MirrorSet::dropLocked(int index) {
+    Entry& entry = entries_[index];
+    if (!entry.live) return true;
+    int live = 0;
+    for (const Entry& other : entries_) {
+        if (other.live) ++live;
+    }
+    if (live <= 1) return false;
+    entry.live = false;
+    LOGE("Dropping mirror %s", entry.mirror.url.c_str());
+    return true;
+}
+
+bool MirrorSet::resolveAll() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<size_t> failed;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        Mirror& mirror = entries_[i].mirror;
+        if (!DnsResolver::shared().resolve(mirror.host, mirror.port, mirror.addrs)) {
+            failed.push_back(i);
+        }
+    }
+    if (failed.size() == entries_.size()) return false;
+    for (size_t index : failed) {
+        dropLocked(static_cast<int>(index));
+    }
+    return true;
+}
+
+void MirrorSet::logSummary() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entries_.size() < 2) return;
+    for (const Entry& entry : entries_) {
+        LOGI("Mirror %s: %lld bytes, %.0f KiB/s per connection%s", entry.mirror.url.c_str(),
+             (long long)entry.bytes, entry.rate * 1000.0 / 1024.0,
+             entry.live ? "" : ", dropped");
+    }
+}
+
+}
@@ -0,0 +1,78 @@
+#ifndef ORION_MIRROR_SET_H
+#define ORION_MIRROR_SET_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "dns_resolver.h"
+
+namespace orion {
+
+struct Mirror {
+    std::string url;
+    std::string host;
+    std::string path;
+    int port = 80;
+    // Validator from the probe; every range response must still carry it.
+    std::string etag;
+    // Resolved only for the event loop backend, which connects by address.
+    std::vector<ResolvedAddress> addrs;
+};
+
+// Equivalent sources for one download. Connections are spread so each
+// mirror's share follows its measured per-connection rate, which lets the
+// scheduler's work stealing hand the fast ones most of the bytes. A mirror
+// that fails MAX_FAILURES attempts in a row, or answers with something a
+// retry cannot fix, is dropped; the last live one never is, so running out
+// of mirrors falls through to the engine's own retry budget.
+// Mirrors are added before connections start and never removed, so the
+// references at() hands out stay valid for the whole download.
+class MirrorSet {
+public:
+    static constexpr int MAX_FAILURES = 3;
+
+    void clear();
+    void add(const Mirror& mirror);
+    size_t size() const { return entries_.size(); }
+    const Mirror& at(int index) const { return entries_[index].mirror; }
+
+    // Returns the mirror a connection should use for its next segment,
+    // staying on current unless another is clearly less loaded; -1 means
+    // no mirror is live. Pass -1 for a connection that has none yet.
+    int assign(int current);
+    // Places a connection that is already talking to a mirror.
+    void join(int index);
+    void leave(int index);
+    // Fills in addresses, dropping mirrors that do not resolve as long as
+    // one does. Returns false if none do.
+    bool resolveAll();
+
+    void recordSuccess(int index, int64_t bytes, int64_t elapsed_ms);
+    // Returns true if the mirror was dropped.
+    bool recordFailure(int index);
+    bool drop(int index);
+
+    void logSummary() const;
+
+private:
+    struct Entry {
+        Mirror mirror;
+        bool live = true;
+        int connections = 0;
+        int failures = 0;
+        // Bytes per millisecond per connection; 0 until a segment completes.
+        double rate = 0.0;
+        int64_t bytes = 0;
+    };
+
+    double loadAfterJoining(const Entry& entry, double fallback_rate) const;
+    bool dropLocked(int index);
+
+    mutable std::mutex mutex_;
+    std::vector<Entry> entries_;
+};
+
+}
+
+#endif
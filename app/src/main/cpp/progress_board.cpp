@@ -0,0 +1,75 @@
+#include "progress_board.h"
+#include "download_engine.h"
+
+namespace orion {
+
+static_assert(sizeof(ProgressBoard::Slot) == 64, "slot layout is shared with Kotlin");
+static_assert(sizeof(std::atomic<double>) == 8 && alignof(std::atomic<double>) == 8,
+              "speed is read as a 64-bit field");
+
+ProgressBoard& ProgressBoard::shared() {
+    static ProgressBoard instance;
+    return instance;
+}
+
+ProgressBoard::ProgressBoard()
+    : slots_(new Slot[SLOT_COUNT]) {
+    free_.reserve(SLOT_COUNT);
+    for (int i = SLOT_COUNT - 1; i >= 0; --i) {
+        Slot& slot = slots_[i];
+        slot.generation.store(0);
+        slot.downloaded_bytes.store(0);
+        slot.total_bytes.store(0);
+        slot.speed_bps.store(0.0);
+        slot.eta_seconds.store(-1);
+        slot.active_connections.store(0);
+        slot.downloading.store(0);
+        slot.decoded_bytes.store(0);
+        free_.push_back(i);
+    }
+}
+
+int ProgressBoard::acquire() {
+    int slot;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.empty()) return -1;
+        slot = free_.back();
+        free_.pop_back();
+    }
+
+    DownloadProgress empty = {};
+    empty.eta_seconds = -1;
+    // Cleared before the new generation shows, so its handle never reads
+    // the previous download's figures.
+    publish(slot, empty, false);
+    slots_[slot].generation.fetch_add(1, std::memory_order_release);
+    return slot;
+}
+
+void ProgressBoard::release(int slot) {
+    if (slot < 0) return;
+    slots_[slot].generation.fetch_add(1, std::memory_order_release);
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(slot);
+}
+
+void ProgressBoard::publish(int slot, const DownloadProgress& progress, bool downloading) {
+    if (slot < 0) return;
+    Slot& target = slots_[slot];
+    target.downloaded_bytes.store(progress.downloaded_bytes, std::memory_order_relaxed);
+    target.total_bytes.store(progress.total_bytes, std::memory_order_relaxed);
+    target.speed_bps.store(progress.speed_bps, std::memory_order_relaxed);
+    target.eta_seconds.store(progress.eta_seconds, std::memory_order_relaxed);
+    target.active_connections.store(progress.active_connections, std::memory_order_relaxed);
+    target.downloading.store(downloading ? 1 : 0, std::memory_order_relaxed);
+    target.decoded_bytes.store(progress.decoded_bytes, std::memory_order_relaxed);
+}
+
+int64_t ProgressBoard::handle(int slot) const {
+    if (slot < 0) return -1;
+    int64_t generation = slots_[slot].generation.load(std::memory_order_relaxed) & 0x7fffffff;
+    return (generation << 32) | slot;
+}
+
+}
@@ -0,0 +1,64 @@
+#ifndef ORION_PROGRESS_BOARD_H
+#define ORION_PROGRESS_BOARD_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace orion {
+
+struct DownloadProgress;
+
+// Fixed block of progress slots that Kotlin maps once as a direct
+// ByteBuffer and reads without JNI calls (see NativeProgressBoard.kt). The
+// memory is never freed, so a reader holding a stale handle sees a
+// generation mismatch rather than a dangling pointer.
+//
+// There is no seqlock: Kotlin has no acquire loads below API 33, so it
+// could not order the checks around the payload. Instead every field is an
+// aligned 64-bit value written with a single store, a reader may see
+// fields from two neighbouring publishes, which for progress is harmless,
+// and the generation, read before and after the fields, tells it whether
+// the slot still belongs to its download.
+class ProgressBoard {
+public:
+    static constexpr int SLOT_COUNT = 256;
+
+    // Byte layout of one slot; keep in sync with NativeProgressBoard.kt.
+    struct alignas(64) Slot {
+        std::atomic<int64_t> generation;
+        std::atomic<int64_t> downloaded_bytes;
+        std::atomic<int64_t> total_bytes;
+        std::atomic<double> speed_bps;
+        std::atomic<int64_t> eta_seconds;
+        std::atomic<int64_t> active_connections;
+        std::atomic<int64_t> downloading;
+        std::atomic<int64_t> decoded_bytes;
+    };
+
+    static ProgressBoard& shared();
+
+    ProgressBoard();
+
+    // Returns -1 when every slot is taken; callers then only serve JNI polls.
+    int acquire();
+    void release(int slot);
+    void publish(int slot, const DownloadProgress& progress, bool downloading);
+    // Slot index in the low 32 bits, generation in the high 32; -1 if none.
+    int64_t handle(int slot) const;
+
+    void* data() { return slots_.get(); }
+    size_t size() const { return sizeof(Slot) * SLOT_COUNT; }
+
+private:
+    std::unique_ptr<Slot[]> slots_;
+    std::mutex mutex_;
+    std::vector<int> free_;
+};
+
+}
+
+#endif
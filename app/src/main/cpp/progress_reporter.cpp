@@ -0,0 +1,117 @@
+#include "progress_reporter.h"
+#include "download_engine.h"
+#include <algorithm>
+#include <chrono>
+
+namespace orion {
+
+static int64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool contains(const std::vector<DownloadEngine*>& engines, DownloadEngine* engine) {
+    return std::find(engines.begin(), engines.end(), engine) != engines.end();
+}
+
+ProgressReporter& ProgressReporter::shared() {
+    static ProgressReporter instance;
+    return instance;
+}
+
+ProgressReporter::ProgressReporter()
+    : stopping_(false) {
+}
+
+ProgressReporter::~ProgressReporter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void ProgressReporter::add(DownloadEngine* engine) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!contains(engines_, engine)) {
+            engines_.push_back(engine);
+        }
+        if (!thread_.joinable()) {
+            thread_ = std::thread(&ProgressReporter::run, this);
+        }
+    }
+    cv_.notify_all();
+}
+
+void ProgressReporter::remove(DownloadEngine* engine) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = std::find(engines_.begin(), engines_.end(), engine);
+    if (it == engines_.end()) return;
+
+    // Called from inside a callback: the engine is not mid-sample anywhere else.
+    if (std::this_thread::get_id() == thread_.get_id()) {
+        engines_.erase(it);
+        return;
+    }
+
+    if (!contains(retiring_, engine)) {
+        retiring_.push_back(engine);
+    }
+    cv_.notify_all();
+    removed_cv_.wait(lock, [this, engine] { return !contains(engines_, engine); });
+}
+
+bool ProgressReporter::isReporterThread() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::this_thread::get_id() == thread_.get_id();
+}
+
+void ProgressReporter::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto next_sample = std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(SAMPLE_INTERVAL_MS);
+
+    while (!stopping_) {
+        // Nothing to sample: sleep until a download starts instead of ticking.
+        if (engines_.empty()) {
+            cv_.wait(lock, [this] { return stopping_ || !engines_.empty(); });
+            next_sample = std::chrono::steady_clock::now() +
+                std::chrono::milliseconds(SAMPLE_INTERVAL_MS);
+            continue;
+        }
+
+        cv_.wait_until(lock, next_sample, [this] { return stopping_ || !retiring_.empty(); });
+        if (stopping_) break;
+
+        // Engines only leave through retiring_, so the batch stays valid
+        // while the lock is dropped for the callbacks.
+        bool due = std::chrono::steady_clock::now() >= next_sample;
+        std::vector<DownloadEngine*> retiring;
+        retiring.swap(retiring_);
+        std::vector<DownloadEngine*> batch = due ? engines_ : retiring;
+        if (due) {
+            next_sample = std::chrono::steady_clock::now() +
+                std::chrono::milliseconds(SAMPLE_INTERVAL_MS);
+        }
+
+        lock.unlock();
+        int64_t now = nowMs();
+        for (DownloadEngine* engine : batch) {
+            engine->sampleProgress(now);
+        }
+        lock.lock();
+
+        for (DownloadEngine* engine : retiring) {
+            engines_.erase(std::remove(engines_.begin(), engines_.end(), engine), engines_.end());
+        }
+        if (!retiring.empty()) {
+            removed_cv_.notify_all();
+        }
+    }
+}
+
+}
@@ -0,0 +1,47 @@
+#ifndef ORION_PROGRESS_REPORTER_H
+#define ORION_PROGRESS_REPORTER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace orion {
+
+class DownloadEngine;
+
+// One sampling thread for every running download. It aggregates each
+// engine's per-connection byte counters on a fixed interval and is the only
+// thread that invokes progress callbacks, so receive loops never touch
+// shared progress state beyond their own counter.
+class ProgressReporter {
+public:
+    static constexpr int SAMPLE_INTERVAL_MS = 250;
+
+    static ProgressReporter& shared();
+
+    ProgressReporter();
+    ~ProgressReporter();
+
+    void add(DownloadEngine* engine);
+    // Samples the engine one last time, then forgets it. Once this returns
+    // the reporter no longer touches the engine.
+    void remove(DownloadEngine* engine);
+    // True on the thread that delivers progress callbacks.
+    bool isReporterThread();
+
+private:
+    void run();
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable removed_cv_;
+    std::vector<DownloadEngine*> engines_;
+    std::vector<DownloadEngine*> retiring_;
+    std::thread thread_;
+    bool stopping_;
+};
+
+}
+
+#endif
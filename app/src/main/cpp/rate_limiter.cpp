@@ -0,0 +1,58 @@
+#include "rate_limiter.h"
+#include <algorithm>
+#include <chrono>
+
+namespace orion {
+
+constexpr int64_t BURST_US = 50000;
+constexpr size_t MIN_CHUNK = 4096;
+
+static int64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+RateLimiter& RateLimiter::global() {
+    static RateLimiter instance;
+    return instance;
+}
+
+RateLimiter::RateLimiter()
+    : rate_(0)
+    , full_at_us_(0) {
+}
+
+void RateLimiter::setRate(int64_t bytes_per_second) {
+    full_at_us_.store(nowUs(), std::memory_order_relaxed);
+    rate_.store(std::max<int64_t>(bytes_per_second, 0), std::memory_order_relaxed);
+}
+
+size_t RateLimiter::chunk(size_t wanted) const {
+    int64_t rate = this->rate();
+    if (rate <= 0) return wanted;
+    size_t burst = static_cast<size_t>(std::max<int64_t>(rate * BURST_US / 1000000, MIN_CHUNK));
+    return std::min(wanted, burst);
+}
+
+int64_t RateLimiter::reserve(int64_t bytes) {
+    int64_t rate = this->rate();
+    if (rate <= 0 || bytes <= 0) return 0;
+
+    int64_t cost = bytes * 1000000 / rate;
+    int64_t now = nowUs();
+    int64_t full_at = full_at_us_.load(std::memory_order_relaxed);
+    int64_t next;
+    do {
+        next = std::max(full_at, now) + cost;
+    } while (!full_at_us_.compare_exchange_weak(full_at, next, std::memory_order_relaxed));
+
+    return std::max<int64_t>(next - BURST_US - now, 0);
+}
+
+void RateLimiter::refund(int64_t bytes) {
+    int64_t rate = this->rate();
+    if (rate <= 0 || bytes <= 0) return;
+    full_at_us_.fetch_sub(bytes * 1000000 / rate, std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,37 @@
+#ifndef ORION_RATE_LIMITER_H
+#define ORION_RATE_LIMITER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace orion {
+
+// Lock-free token bucket in its GCRA form: a single atomic holds the time at
+// which the bucket would be full again. Readers reserve bytes before a recv
+// and get back how long to wait, so nobody polls and a limit of 0 costs one
+// relaxed load per read.
+class RateLimiter {
+public:
+    static RateLimiter& global();
+
+    RateLimiter();
+
+    void setRate(int64_t bytes_per_second);
+    int64_t rate() const { return rate_.load(std::memory_order_relaxed); }
+    bool limited() const { return rate() > 0; }
+
+    // Largest read that fits in one burst; unlimited buckets return wanted.
+    size_t chunk(size_t wanted) const;
+    // Returns microseconds to wait before reading the reserved bytes.
+    int64_t reserve(int64_t bytes);
+    void refund(int64_t bytes);
+
+private:
+    std::atomic<int64_t> rate_;
+    std::atomic<int64_t> full_at_us_;
+};
+
+}
+
+#endif
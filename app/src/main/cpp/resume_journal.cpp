@@ -0,0 +1,301 @@
+#include "resume_journal.h"
+#include "log.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+
+#define LOG_TAG "OrionJournal"
+#define LOGD(...) orion::logPrint(orion::LogLevel::Debug, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) orion::logPrint(orion::LogLevel::Error, LOG_TAG, __VA_ARGS__)
+
+namespace orion {
+
+constexpr char JOURNAL_MAGIC[4] = {'O', 'R', 'N', 'J'};
+constexpr uint32_t JOURNAL_VERSION = 1;
+constexpr int64_t JOURNAL_BLOCK_SIZE = 256 * 1024;
+constexpr int64_t FLUSH_INTERVAL_MS = 1000;
+
+struct JournalHeader {
+    char magic[4];
+    uint32_t version;
+    int64_t total_size;
+    uint32_t block_size;
+    uint32_t url_length;
+    uint32_t etag_length;
+    uint32_t last_modified_length;
+};
+
+static int64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool readFully(int fd, void* data, size_t length, int64_t offset) {
+    char* out = static_cast<char*>(data);
+    while (length > 0) {
+        ssize_t n = pread(fd, out, length, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        out += n;
+        length -= n;
+        offset += n;
+    }
+    return true;
+}
+
+static bool writeFully(int fd, const void* data, size_t length, int64_t offset) {
+    const char* in = static_cast<const char*>(data);
+    while (length > 0) {
+        ssize_t n = pwrite(fd, in, length, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        in += n;
+        length -= n;
+        offset += n;
+    }
+    return true;
+}
+
+static bool readHeader(int fd, JournalHeader& header, JournalState* state, int64_t& bitmap_offset) {
+    if (!readFully(fd, &header, sizeof(header), 0)) return false;
+    if (memcmp(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0 ||
+        header.version != JOURNAL_VERSION ||
+        header.block_size != JOURNAL_BLOCK_SIZE ||
+        header.total_size <= 0) {
+        return false;
+    }
+
+    int64_t offset = sizeof(header);
+    std::string strings(header.url_length + header.etag_length + header.last_modified_length, '\0');
+    if (!strings.empty() && !readFully(fd, &strings[0], strings.size(), offset)) return false;
+
+    if (state) {
+        state->url = strings.substr(0, header.url_length);
+        state->etag = strings.substr(header.url_length, header.etag_length);
+        state->last_modified = strings.substr(header.url_length + header.etag_length);
+        state->total_size = header.total_size;
+    }
+
+    bitmap_offset = offset + static_cast<int64_t>(strings.size());
+    return true;
+}
+
+ResumeJournal::ResumeJournal()
+    : fd_(-1)
+    , total_size_(0)
+    , block_count_(0)
+    , bitmap_offset_(0)
+    , dirty_(false)
+    , last_flush_ms_(0) {
+}
+
+ResumeJournal::~ResumeJournal() {
+    close();
+}
+
+std::string ResumeJournal::pathFor(const std::string& output_path) {
+    return output_path + ".orion";
+}
+
+bool ResumeJournal::load(const std::string& output_path, JournalState& state) {
+    int fd = ::open(pathFor(output_path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    JournalHeader header;
+    int64_t bitmap_offset = 0;
+    if (!readHeader(fd, header, &state, bitmap_offset)) {
+        ::close(fd);
+        return false;
+    }
+
+    int64_t blocks = (header.total_size + JOURNAL_BLOCK_SIZE - 1) / JOURNAL_BLOCK_SIZE;
+    std::vector<uint8_t> bitmap((blocks + 7) / 8);
+    bool ok = readFully(fd, bitmap.data(), bitmap.size(), bitmap_offset);
+    ::close(fd);
+    if (!ok) return false;
+
+    state.missing_ranges.clear();
+    for (int64_t block = 0; block < blocks; ++block) {
+        if (bitmap[block / 8] & (1u << (block % 8))) continue;
+        int64_t start = block * JOURNAL_BLOCK_SIZE;
+        int64_t end = std::min(start + JOURNAL_BLOCK_SIZE, header.total_size) - 1;
+        if (!state.missing_ranges.empty() && state.missing_ranges.back().second + 1 == start) {
+            state.missing_ranges.back().second = end;
+        } else {
+            state.missing_ranges.emplace_back(start, end);
+        }
+    }
+    return true;
+}
+
+bool ResumeJournal::create(const std::string& output_path, const std::string& url,
+                           const std::string& etag, const std::string& last_modified,
+                           int64_t total_size) {
+    close();
+    path_ = pathFor(output_path);
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        LOGE("Failed to create journal %s: %s", path_.c_str(), strerror(errno));
+        return false;
+    }
+
+    JournalHeader header;
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    header.version = JOURNAL_VERSION;
+    header.total_size = total_size;
+    header.block_size = JOURNAL_BLOCK_SIZE;
+    header.url_length = static_cast<uint32_t>(url.size());
+    header.etag_length = static_cast<uint32_t>(etag.size());
+    header.last_modified_length = static_cast<uint32_t>(last_modified.size());
+
+    std::string blob(reinterpret_cast<const char*>(&header), sizeof(header));
+    blob += url;
+    blob += etag;
+    blob += last_modified;
+
+    total_size_ = total_size;
+    block_count_ = (total_size + JOURNAL_BLOCK_SIZE - 1) / JOURNAL_BLOCK_SIZE;
+    bitmap_offset_ = static_cast<int64_t>(blob.size());
+    bitmap_.assign((block_count_ + 7) / 8, 0);
+    blob.append(reinterpret_cast<const char*>(bitmap_.data()), bitmap_.size());
+
+    if (!writeFully(fd_, blob.data(), blob.size(), 0)) {
+        LOGE("Failed to write journal header: %s", strerror(errno));
+        remove();
+        return false;
+    }
+
+    block_bytes_.reset(new std::atomic<uint32_t>[block_count_]);
+    for (int64_t i = 0; i < block_count_; ++i) block_bytes_[i].store(0);
+    dirty_.store(false);
+    last_flush_ms_.store(nowMs());
+    return true;
+}
+
+bool ResumeJournal::open(const std::string& output_path, int64_t total_size) {
+    close();
+    path_ = pathFor(output_path);
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd_ < 0) return false;
+
+    JournalHeader header;
+    if (!readHeader(fd_, header, nullptr, bitmap_offset_) || header.total_size != total_size) {
+        close();
+        return false;
+    }
+
+    total_size_ = total_size;
+    block_count_ = (total_size + JOURNAL_BLOCK_SIZE - 1) / JOURNAL_BLOCK_SIZE;
+    bitmap_.assign((block_count_ + 7) / 8, 0);
+    if (!readFully(fd_, bitmap_.data(), bitmap_.size(), bitmap_offset_)) {
+        close();
+        return false;
+    }
+
+    block_bytes_.reset(new std::atomic<uint32_t>[block_count_]);
+    for (int64_t i = 0; i < block_count_; ++i) {
+        bool done = bitmap_[i / 8] & (1u << (i % 8));
+        block_bytes_[i].store(done ? static_cast<uint32_t>(blockLength(i)) : 0);
+    }
+    dirty_.store(false);
+    last_flush_ms_.store(nowMs());
+    return true;
+}
+
+int64_t ResumeJournal::blockLength(int64_t block) const {
+    int64_t start = block * JOURNAL_BLOCK_SIZE;
+    return std::min(JOURNAL_BLOCK_SIZE, total_size_ - start);
+}
+
+void ResumeJournal::markBlock(int64_t block) {
+    std::lock_guard<std::mutex> lock(bitmap_mutex_);
+    bitmap_[block / 8] |= static_cast<uint8_t>(1u << (block % 8));
+    dirty_.store(true);
+}
+
+void ResumeJournal::markWritten(int64_t offset, int64_t length) {
+    if (fd_ < 0 || length <= 0) return;
+
+    int64_t end = offset + length;
+    for (int64_t block = offset / JOURNAL_BLOCK_SIZE; block < block_count_; ++block) {
+        int64_t block_start = block * JOURNAL_BLOCK_SIZE;
+        if (block_start >= end) break;
+        int64_t overlap = std::min(end, block_start + JOURNAL_BLOCK_SIZE) - std::max(offset, block_start);
+        uint32_t filled = block_bytes_[block].fetch_add(static_cast<uint32_t>(overlap)) +
+                          static_cast<uint32_t>(overlap);
+        if (filled == blockLength(block)) {
+            markBlock(block);
+        }
+    }
+}
+
+void ResumeJournal::markMissing(int64_t offset, int64_t length) {
+    if (fd_ < 0 || length <= 0) return;
+
+    int64_t end = offset + length;
+    for (int64_t block = offset / JOURNAL_BLOCK_SIZE; block < block_count_; ++block) {
+        int64_t block_start = block * JOURNAL_BLOCK_SIZE;
+        if (block_start >= end) break;
+        int64_t overlap = std::min(end, block_start + JOURNAL_BLOCK_SIZE) - std::max(offset, block_start);
+        block_bytes_[block].fetch_sub(static_cast<uint32_t>(overlap));
+
+        std::lock_guard<std::mutex> lock(bitmap_mutex_);
+        bitmap_[block / 8] &= static_cast<uint8_t>(~(1u << (block % 8)));
+        dirty_.store(true);
+    }
+}
+
+void ResumeJournal::flushIfDue(int data_fd) {
+    if (fd_ < 0 || !dirty_.load(std::memory_order_relaxed)) return;
+    if (nowMs() - last_flush_ms_.load(std::memory_order_relaxed) < FLUSH_INTERVAL_MS) return;
+
+    std::unique_lock<std::mutex> lock(flush_mutex_, std::try_to_lock);
+    if (lock.owns_lock()) {
+        flushLocked(data_fd);
+    }
+}
+
+void ResumeJournal::flush(int data_fd) {
+    std::lock_guard<std::mutex> lock(flush_mutex_);
+    flushLocked(data_fd);
+}
+
+void ResumeJournal::flushLocked(int data_fd) {
+    if (fd_ < 0 || !dirty_.exchange(false)) return;
+
+    // Data must be durable before the bitmap claims it. Blocks are marked
+    // after their write, so everything in a snapshot taken ahead of the sync
+    // is covered by it; later marks wait for the next flush.
+    std::vector<uint8_t> snapshot;
+    {
+        std::lock_guard<std::mutex> bitmap_lock(bitmap_mutex_);
+        snapshot = bitmap_;
+    }
+    if (data_fd >= 0) fdatasync(data_fd);
+
+    if (!writeFully(fd_, snapshot.data(), snapshot.size(), bitmap_offset_)) {
+        LOGE("Failed to update journal: %s", strerror(errno));
+        dirty_.store(true);
+    }
+    last_flush_ms_.store(nowMs());
+}
+
+void ResumeJournal::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+void ResumeJournal::remove() {
+    close();
+    if (!path_.empty()) {
+        unlink(path_.c_str());
+        LOGD("Journal removed: %s", path_.c_str());
+    }
+}
+
+}
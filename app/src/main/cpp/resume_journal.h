@@ -0,0 +1,67 @@
+#ifndef ORION_RESUME_JOURNAL_H
+#define ORION_RESUME_JOURNAL_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace orion {
+
+struct JournalState {
+    std::string url;
+    std::string etag;
+    std::string last_modified;
+    int64_t total_size;
+    std::vector<std::pair<int64_t, int64_t>> missing_ranges;
+};
+
+// Sidecar file next to the output recording which fixed-size blocks are
+// already on disk. Blocks are counted in memory and the bitmap is rewritten
+// at most once per flush interval, after the data file has been synced.
+class ResumeJournal {
+public:
+    ResumeJournal();
+    ~ResumeJournal();
+
+    static std::string pathFor(const std::string& output_path);
+    static bool load(const std::string& output_path, JournalState& state);
+
+    bool create(const std::string& output_path, const std::string& url,
+                const std::string& etag, const std::string& last_modified,
+                int64_t total_size);
+    bool open(const std::string& output_path, int64_t total_size);
+
+    void markWritten(int64_t offset, int64_t length);
+    void markMissing(int64_t offset, int64_t length);
+    void flushIfDue(int data_fd);
+    void flush(int data_fd);
+    void close();
+    void remove();
+
+    bool isOpen() const { return fd_ >= 0; }
+
+private:
+    void flushLocked(int data_fd);
+    void markBlock(int64_t block);
+    int64_t blockLength(int64_t block) const;
+
+    int fd_;
+    std::string path_;
+    int64_t total_size_;
+    int64_t block_count_;
+    int64_t bitmap_offset_;
+    std::vector<uint8_t> bitmap_;
+    std::unique_ptr<std::atomic<uint32_t>[]> block_bytes_;
+    std::atomic<bool> dirty_;
+    std::atomic<int64_t> last_flush_ms_;
+    std::mutex flush_mutex_;
+    std::mutex bitmap_mutex_;
+};
+
+}
+
+#endif
@@ -0,0 +1,310 @@
+#include "segment_scheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+namespace orion {
+
+constexpr int64_t MIN_SEGMENT_SIZE = 1024 * 1024;
+constexpr int64_t MAX_SEGMENT_SIZE = 64 * 1024 * 1024;
+constexpr int64_t MIN_STEAL_SIZE = 256 * 1024;
+constexpr int64_t MIN_RATE_SAMPLE = 256 * 1024;
+constexpr int64_t HEDGE_LAG_FACTOR = 2;
+constexpr int64_t MIN_HEDGE_GAIN_US = 200000;
+// Duplicate requests may cover at most 1/8 of the file.
+constexpr int64_t HEDGE_BUDGET_SHARE = 8;
+
+static int64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+SegmentScheduler::SegmentScheduler()
+    : total_size_(0)
+    , next_offset_(0)
+    , num_connections_(1)
+    , first_segment_(0)
+    , allow_split_(false)
+    , endgame_bytes_(0)
+    , best_rate_(0)
+    , hedged_bytes_(0)
+    , hedges_(0)
+    , hedges_won_(0)
+    , wasted_bytes_(0) {
+}
+
+void SegmentScheduler::reset(int64_t total_size, int num_connections, bool allow_split,
+                             int64_t first_segment) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    segments_.clear();
+    total_size_ = total_size;
+    next_offset_ = 0;
+    num_connections_ = std::max(num_connections, 1);
+    first_segment_ = first_segment;
+    allow_split_ = allow_split;
+    best_rate_ = hedged_bytes_ = 0;
+    hedges_ = hedges_won_ = wasted_bytes_ = 0;
+}
+
+void SegmentScheduler::resetMissing(int64_t total_size, int num_connections,
+                                    const std::vector<std::pair<int64_t, int64_t>>& missing) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    segments_.clear();
+    for (const auto& range : missing) {
+        segments_.push_back({range.first, range.second, 0, -1, false});
+    }
+    total_size_ = total_size;
+    next_offset_ = total_size;
+    num_connections_ = std::max(num_connections, 1);
+    first_segment_ = 0;
+    allow_split_ = true;
+    best_rate_ = hedged_bytes_ = 0;
+    hedges_ = hedges_won_ = wasted_bytes_ = 0;
+}
+
+void SegmentScheduler::setEndgame(int64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    endgame_bytes_ = bytes;
+}
+
+// A hedged pair is counted once, from wherever its faster copy has reached.
+int64_t SegmentScheduler::remainingLocked(const Segment& segment) const {
+    if (segment.completed || segment.hedge) return 0;
+    int64_t placed = segment.start + segment.downloaded;
+    if (segment.twin >= 0) {
+        const Segment& copy = segments_[segment.twin];
+        placed = std::max(placed, copy.start + copy.downloaded);
+    }
+    return std::max<int64_t>(segment.end - placed + 1, 0);
+}
+
+void SegmentScheduler::leaseLocked(int segment_id, int connection_id, SegmentLease& lease) {
+    Segment& segment = segments_[segment_id];
+    segment.owner = connection_id;
+    segment.leased_at = nowUs();
+    segment.leased_bytes = segment.downloaded;
+    lease.segment_id = segment_id;
+    lease.offset = segment.start + segment.downloaded;
+    lease.end = segment.end;
+}
+
+bool SegmentScheduler::acquire(int connection_id, SegmentLease& lease) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (size_t i = 0; i < segments_.size(); ++i) {
+        if (segments_[i].owner < 0 && !segments_[i].completed) {
+            leaseLocked(static_cast<int>(i), connection_id, lease);
+            return true;
+        }
+    }
+
+    if (next_offset_ < total_size_) {
+        int64_t remaining = total_size_ - next_offset_;
+        int64_t size = remaining;
+        if (allow_split_ && next_offset_ == 0 && first_segment_ > 0) {
+            // Matches the span the metadata probe already requested.
+            size = std::min(first_segment_, remaining);
+        } else if (allow_split_) {
+            size = std::min(std::max(remaining / (num_connections_ * 2), MIN_SEGMENT_SIZE),
+                            MAX_SEGMENT_SIZE);
+            size = std::min(size, remaining);
+        }
+        segments_.push_back({next_offset_, next_offset_ + size - 1, 0, -1, false});
+        next_offset_ += size;
+        leaseLocked(static_cast<int>(segments_.size()) - 1, connection_id, lease);
+        return true;
+    }
+
+    if (!allow_split_) return false;
+
+    int victim = -1;
+    int64_t victim_remaining = 0;
+    for (size_t i = 0; i < segments_.size(); ++i) {
+        const Segment& segment = segments_[i];
+        if (segment.completed || segment.owner < 0 || segment.twin >= 0) continue;
+        int64_t remaining = segment.end - (segment.start + segment.downloaded) + 1;
+        if (remaining > victim_remaining) {
+            victim = static_cast<int>(i);
+            victim_remaining = remaining;
+        }
+    }
+
+    if (victim < 0 || victim_remaining < MIN_STEAL_SIZE * 2) {
+        return hedgeLocked(connection_id, lease);
+    }
+
+    Segment& donor = segments_[victim];
+    int64_t split = donor.start + donor.downloaded + victim_remaining / 2;
+    int64_t stolen_end = donor.end;
+    donor.end = split - 1;
+    segments_.push_back({split, stolen_end, 0, -1, false});
+    leaseLocked(static_cast<int>(segments_.size()) - 1, connection_id, lease);
+    return true;
+}
+
+bool SegmentScheduler::hedgeLocked(int connection_id, SegmentLease& lease) {
+    if (endgame_bytes_ <= 0 || best_rate_ <= 0) return false;
+
+    int64_t now = nowUs();
+    int64_t remaining = total_size_ - next_offset_;
+    int target = -1;
+    int64_t target_gain = 0;
+    for (size_t i = 0; i < segments_.size(); ++i) {
+        const Segment& segment = segments_[i];
+        int64_t left = remainingLocked(segment);
+        remaining += left;
+        if (segment.owner < 0 || segment.owner == connection_id || segment.twin >= 0) continue;
+        int64_t elapsed = now - segment.leased_at;
+        if (left <= 0 || elapsed < MIN_HEDGE_GAIN_US) continue;
+
+        // Finish at the owner's pace so far against a fresh copy at the best pace.
+        int64_t moved = segment.downloaded - segment.leased_bytes;
+        int64_t projected = moved > 0 ? left * elapsed / moved
+                                      : std::numeric_limits<int64_t>::max();
+        int64_t fresh = left * 1000000 / best_rate_;
+        if (projected / HEDGE_LAG_FACTOR < fresh || projected - fresh < MIN_HEDGE_GAIN_US) continue;
+        if (projected - fresh > target_gain) {
+            target = static_cast<int>(i);
+            target_gain = projected - fresh;
+        }
+    }
+    if (target < 0 || remaining > endgame_bytes_) {
+        return false;
+    }
+
+    const Segment& original = segments_[target];
+    int64_t length = original.end - (original.start + original.downloaded) + 1;
+    if (hedged_bytes_ + length > total_size_ / HEDGE_BUDGET_SHARE) {
+        return false;
+    }
+    hedged_bytes_ += length;
+
+    Segment copy{original.start + original.downloaded, original.end, 0, -1, false};
+    copy.twin = target;
+    copy.hedge = true;
+    segments_.push_back(copy);
+    int copy_id = static_cast<int>(segments_.size()) - 1;
+    segments_[target].twin = copy_id;
+    ++hedges_;
+    leaseLocked(copy_id, connection_id, lease);
+    return true;
+}
+
+int64_t SegmentScheduler::take(int segment_id, int64_t bytes, int64_t& offset, bool& finished,
+                               int64_t& skipped) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Segment& segment = segments_[segment_id];
+    offset = segment.start + segment.downloaded;
+    if (segment.completed) {
+        // The other copy got there first.
+        finished = true;
+        skipped = bytes;
+        wasted_bytes_ += bytes;
+        return 0;
+    }
+    int64_t granted = std::min(bytes, segment.end - offset + 1);
+    segment.downloaded += granted;
+    finished = segment.start + segment.downloaded > segment.end;
+    skipped = 0;
+    if (segment.twin >= 0) {
+        Segment& other = segments_[segment.twin];
+        skipped = std::min(std::max<int64_t>(other.start + other.downloaded - offset, 0), granted);
+        wasted_bytes_ += skipped;
+        offset += skipped;
+        granted -= skipped;
+        if (finished) {
+            other.completed = true;
+            other.owner = -1;
+            if (segment.hedge) ++hedges_won_;
+        }
+    }
+    if (finished) {
+        int64_t elapsed = nowUs() - segment.leased_at;
+        int64_t moved = segment.downloaded - segment.leased_bytes;
+        if (moved >= MIN_RATE_SAMPLE && elapsed > 0) {
+            best_rate_ = std::max(best_rate_, moved * 1000000 / elapsed);
+        }
+        segment.completed = true;
+        segment.owner = -1;
+    }
+    return granted;
+}
+
+void SegmentScheduler::release(int segment_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    segments_[segment_id].owner = -1;
+}
+
+void SegmentScheduler::requeue(int64_t start, int64_t end) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    segments_.push_back({start, end, 0, -1, false});
+}
+
+bool SegmentScheduler::isComplete() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (next_offset_ < total_size_) return false;
+    for (const auto& segment : segments_) {
+        if (!segment.completed) return false;
+    }
+    return true;
+}
+
+bool SegmentScheduler::completed(int segment_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return segments_[segment_id].completed;
+}
+
+int SegmentScheduler::twin(int segment_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return segments_[segment_id].twin;
+}
+
+int64_t SegmentScheduler::hedges() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hedges_;
+}
+
+int64_t SegmentScheduler::hedgesWon() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hedges_won_;
+}
+
+int64_t SegmentScheduler::wastedBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return wasted_bytes_;
+}
+
+bool SegmentScheduler::hasAvailableWork() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (next_offset_ < total_size_) return true;
+    for (const auto& segment : segments_) {
+        if (segment.completed) continue;
+        if (segment.owner < 0) return true;
+        int64_t remaining = segment.end - (segment.start + segment.downloaded) + 1;
+        if (allow_split_ && remaining >= MIN_STEAL_SIZE * 2) return true;
+    }
+    return false;
+}
+
+int64_t SegmentScheduler::remainingBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t remaining = total_size_ - next_offset_;
+    for (const auto& segment : segments_) {
+        remaining += remainingLocked(segment);
+    }
+    return remaining;
+}
+
+std::vector<SegmentProgress> SegmentScheduler::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<SegmentProgress> result;
+    result.reserve(segments_.size());
+    for (const auto& segment : segments_) {
+        if (segment.hedge) continue;
+        result.push_back({segment.start, segment.end, segment.downloaded,
+                          segment.owner, segment.completed});
+    }
+    return result;
+}
+
+}
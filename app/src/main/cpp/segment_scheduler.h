@@ -0,0 +1,103 @@
+#ifndef ORION_SEGMENT_SCHEDULER_H
+#define ORION_SEGMENT_SCHEDULER_H
+
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace orion {
+
+struct Segment {
+    int64_t start;
+    int64_t end;
+    int64_t downloaded;
+    int owner;
+    bool completed;
+    // The other copy of a hedged range, and whether this is the duplicate.
+    int twin = -1;
+    bool hedge = false;
+    // Monotonic time and progress when the current owner took the range.
+    int64_t leased_at = 0;
+    int64_t leased_bytes = 0;
+};
+
+struct SegmentProgress {
+    int64_t start;
+    int64_t end;
+    int64_t downloaded;
+    int owner;
+    bool completed;
+};
+
+struct SegmentLease {
+    int segment_id;
+    int64_t offset;
+    int64_t end;
+};
+
+// Hands out byte ranges on demand. Fresh ranges are cut from the unassigned
+// tail with a shrinking size; once the tail is gone an idle connection steals
+// the upper half of the largest range still in flight. When nothing is left
+// to split and at most the endgame threshold remains, an idle connection
+// instead requests a duplicate of a range in flight, but only one whose
+// projected finish at its own pace lags well behind a fresh copy at the best
+// pace seen so far, and only while the duplicates stay within a fixed share
+// of the file. The two copies race: each writes only past what the other
+// already placed, and the first to reach the end completes both.
+class SegmentScheduler {
+public:
+    SegmentScheduler();
+
+    void reset(int64_t total_size, int num_connections, bool allow_split,
+               int64_t first_segment = 0);
+    void resetMissing(int64_t total_size, int num_connections,
+                      const std::vector<std::pair<int64_t, int64_t>>& missing);
+
+    bool acquire(int connection_id, SegmentLease& lease);
+    // Grants the next bytes of the segment's range. With a racing copy the
+    // first skipped bytes of the input were already written by it, and the
+    // grant starts at offset after them.
+    int64_t take(int segment_id, int64_t bytes, int64_t& offset, bool& finished,
+                 int64_t& skipped);
+    void release(int segment_id);
+    void requeue(int64_t start, int64_t end);
+    // 0 turns hedging off.
+    void setEndgame(int64_t bytes);
+
+    bool isComplete() const;
+    // True once the range is done, which for a hedged copy may be the
+    // other copy's doing.
+    bool completed(int segment_id) const;
+    int twin(int segment_id) const;
+    int64_t hedges() const;
+    int64_t hedgesWon() const;
+    int64_t wastedBytes() const;
+    bool hasAvailableWork() const;
+    int64_t remainingBytes() const;
+    std::vector<SegmentProgress> snapshot() const;
+
+private:
+    void leaseLocked(int segment_id, int connection_id, SegmentLease& lease);
+    bool hedgeLocked(int connection_id, SegmentLease& lease);
+    int64_t remainingLocked(const Segment& segment) const;
+
+    mutable std::mutex mutex_;
+    std::vector<Segment> segments_;
+    int64_t total_size_;
+    int64_t next_offset_;
+    int num_connections_;
+    int64_t first_segment_;
+    bool allow_split_;
+    int64_t endgame_bytes_;
+    // Fastest finished lease in bytes per second; 0 until one is measured.
+    int64_t best_rate_;
+    int64_t hedged_bytes_;
+    int64_t hedges_;
+    int64_t hedges_won_;
+    int64_t wasted_bytes_;
+};
+
+}
+
+#endif
@@ -0,0 +1,143 @@
+#include "sha256.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(ORION_SHA256_ARMV8)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#if defined(ORION_SHA256_SHANI)
+#include <cpuid.h>
+#endif
+
+namespace orion {
+
+using BlockFunction = void (*)(uint32_t state[8], const uint8_t* data, size_t blocks);
+
+const uint32_t SHA256_ROUND_CONSTANTS[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static void blocksPortable(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    uint32_t w[64];
+    while (blocks--) {
+        for (int i = 0; i < 16; ++i) {
+            w[i] = (uint32_t(data[i * 4]) << 24) | (uint32_t(data[i * 4 + 1]) << 16) |
+                   (uint32_t(data[i * 4 + 2]) << 8) | uint32_t(data[i * 4 + 3]);
+        }
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) +
+                          SHA256_ROUND_CONSTANTS[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+        data += Sha256::BLOCK_SIZE;
+    }
+}
+
+static BlockFunction selectKernel(const char*& name) {
+#if defined(ORION_SHA256_ARMV8)
+    if (getauxval(AT_HWCAP) & HWCAP_SHA2) {
+        name = "armv8-sha2";
+        return sha256BlocksArmv8;
+    }
+#endif
+#if defined(ORION_SHA256_SHANI)
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & (1u << 29)) &&
+        __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & (1u << 19))) {
+        name = "x86-sha-ni";
+        return sha256BlocksShaNi;
+    }
+#endif
+    name = "portable";
+    return blocksPortable;
+}
+
+static const char* kernel_name = nullptr;
+static const BlockFunction compress = selectKernel(kernel_name);
+
+Sha256::Sha256() {
+    reset();
+}
+
+void Sha256::reset() {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(state_, initial, sizeof(state_));
+    buffered_ = 0;
+    length_ = 0;
+}
+
+void Sha256::update(const void* data, size_t length) {
+    const uint8_t* input = static_cast<const uint8_t*>(data);
+    length_ += length;
+
+    if (buffered_ > 0) {
+        size_t fill = std::min(BLOCK_SIZE - buffered_, length);
+        memcpy(buffer_ + buffered_, input, fill);
+        buffered_ += fill;
+        input += fill;
+        length -= fill;
+        if (buffered_ < BLOCK_SIZE) return;
+        compress(state_, buffer_, 1);
+        buffered_ = 0;
+    }
+
+    size_t blocks = length / BLOCK_SIZE;
+    if (blocks > 0) {
+        compress(state_, input, blocks);
+        input += blocks * BLOCK_SIZE;
+        length -= blocks * BLOCK_SIZE;
+    }
+
+    memcpy(buffer_, input, length);
+    buffered_ = length;
+}
+
+void Sha256::finish(uint8_t digest[DIGEST_SIZE]) {
+    uint64_t bits = length_ * 8;
+    uint8_t padding[BLOCK_SIZE * 2] = {0x80};
+    size_t pad = (buffered_ < 56 ? 56 : 120) - buffered_;
+    for (int i = 0; i < 8; ++i) {
+        padding[pad + i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+    }
+    update(padding, pad + 8);
+
+    for (int i = 0; i < 8; ++i) {
+        digest[i * 4] = static_cast<uint8_t>(state_[i] >> 24);
+        digest[i * 4 + 1] = static_cast<uint8_t>(state_[i] >> 16);
+        digest[i * 4 + 2] = static_cast<uint8_t>(state_[i] >> 8);
+        digest[i * 4 + 3] = static_cast<uint8_t>(state_[i]);
+    }
+}
+
+const char* Sha256::kernelName() {
+    return kernel_name;
+}
+
+}
@@ -0,0 +1,40 @@
+#ifndef ORION_SHA256_H
+#define ORION_SHA256_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace orion {
+
+// Incremental SHA-256. Whole blocks go through the fastest compression
+// kernel the CPU offers (ARMv8 SHA2 or x86 SHA-NI), picked once at startup.
+class Sha256 {
+public:
+    static constexpr size_t DIGEST_SIZE = 32;
+    static constexpr size_t BLOCK_SIZE = 64;
+
+    Sha256();
+
+    void reset();
+    void update(const void* data, size_t length);
+    void finish(uint8_t digest[DIGEST_SIZE]);
+
+    static const char* kernelName();
+
+private:
+    uint32_t state_[8];
+    uint8_t buffer_[BLOCK_SIZE];
+    size_t buffered_;
+    uint64_t length_;
+};
+
+extern const uint32_t SHA256_ROUND_CONSTANTS[64];
+
+// Hardware kernels, each built in its own translation unit with the ISA
+// flags it needs. Only called after a runtime CPU feature check.
+void sha256BlocksArmv8(uint32_t state[8], const uint8_t* data, size_t blocks);
+void sha256BlocksShaNi(uint32_t state[8], const uint8_t* data, size_t blocks);
+
+}
+
+#endif
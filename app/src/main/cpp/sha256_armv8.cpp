@@ -0,0 +1,40 @@
+#include "sha256.h"
+#include <arm_neon.h>
+
+namespace orion {
+
+// ARMv8 Cryptography Extension: four rounds per SHA256H/SHA256H2 pair, with
+// the message schedule expanded in registers by SHA256SU0/SU1.
+void sha256BlocksArmv8(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    uint32x4_t abcd = vld1q_u32(&state[0]);
+    uint32x4_t efgh = vld1q_u32(&state[4]);
+
+    while (blocks--) {
+        uint32x4_t abcd_saved = abcd;
+        uint32x4_t efgh_saved = efgh;
+        uint32x4_t msg[4];
+        for (int i = 0; i < 4; ++i) {
+            msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+        }
+
+        for (int i = 0; i < 16; ++i) {
+            uint32x4_t wk = vaddq_u32(msg[i & 3], vld1q_u32(&SHA256_ROUND_CONSTANTS[4 * i]));
+            uint32x4_t abcd_before = abcd;
+            abcd = vsha256hq_u32(abcd, efgh, wk);
+            efgh = vsha256h2q_u32(efgh, abcd_before, wk);
+            if (i < 12) {
+                msg[i & 3] = vsha256su1q_u32(vsha256su0q_u32(msg[i & 3], msg[(i + 1) & 3]),
+                                             msg[(i + 2) & 3], msg[(i + 3) & 3]);
+            }
+        }
+
+        abcd = vaddq_u32(abcd, abcd_saved);
+        efgh = vaddq_u32(efgh, efgh_saved);
+        data += Sha256::BLOCK_SIZE;
+    }
+
+    vst1q_u32(&state[0], abcd);
+    vst1q_u32(&state[4], efgh);
+}
+
+}
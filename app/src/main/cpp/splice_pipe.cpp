@@ -0,0 +1,132 @@
+#include "splice_pipe.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <algorithm>
+#include <utility>
+
+namespace orion {
+
+// Large enough that a fast link needs few round trips through the kernel;
+// the default pipe-max-size lets any process ask for this much.
+constexpr int PIPE_SIZE = 1024 * 1024;
+
+SplicePipe::SplicePipe()
+    : read_fd_(-1)
+    , write_fd_(-1)
+    , capacity_(0)
+    , pending_(0) {
+}
+
+SplicePipe::~SplicePipe() {
+    close();
+}
+
+SplicePipe::SplicePipe(SplicePipe&& other) noexcept
+    : read_fd_(other.read_fd_)
+    , write_fd_(other.write_fd_)
+    , capacity_(other.capacity_)
+    , pending_(other.pending_) {
+    other.read_fd_ = -1;
+    other.write_fd_ = -1;
+    other.capacity_ = 0;
+    other.pending_ = 0;
+}
+
+SplicePipe& SplicePipe::operator=(SplicePipe&& other) noexcept {
+    if (this != &other) {
+        close();
+        std::swap(read_fd_, other.read_fd_);
+        std::swap(write_fd_, other.write_fd_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(pending_, other.pending_);
+    }
+    return *this;
+}
+
+bool SplicePipe::open() {
+    if (isOpen()) return true;
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        return false;
+    }
+    read_fd_ = fds[0];
+    write_fd_ = fds[1];
+    fcntl(write_fd_, F_SETPIPE_SZ, PIPE_SIZE);
+    int size = fcntl(write_fd_, F_GETPIPE_SZ);
+    capacity_ = size > 0 ? static_cast<size_t>(size) : 65536;
+    pending_ = 0;
+    return true;
+}
+
+void SplicePipe::close() {
+    if (read_fd_ >= 0) ::close(read_fd_);
+    if (write_fd_ >= 0) ::close(write_fd_);
+    read_fd_ = -1;
+    write_fd_ = -1;
+    pending_ = 0;
+}
+
+ssize_t SplicePipe::fill(int socket_fd, size_t length) {
+    length = std::min(length, capacity_ - pending_);
+    ssize_t moved;
+    do {
+        moved = splice(socket_fd, nullptr, write_fd_, nullptr, length, SPLICE_F_MOVE | SPLICE_F_MORE);
+    } while (moved < 0 && errno == EINTR);
+    if (moved > 0) pending_ += moved;
+    return moved;
+}
+
+bool SplicePipe::drainTo(int file_fd, int64_t offset, size_t length) {
+    while (length > 0) {
+        loff_t out = static_cast<loff_t>(offset);
+        ssize_t moved = splice(read_fd_, nullptr, file_fd, &out, length, SPLICE_F_MOVE);
+        if (moved < 0 && errno == EINTR) continue;
+        if (moved <= 0) return false;
+        pending_ -= moved;
+        length -= moved;
+        offset += moved;
+    }
+    return true;
+}
+
+bool SplicePipe::copyTo(int file_fd, int64_t offset, size_t length, char* scratch,
+                        size_t scratch_size) {
+    while (length > 0) {
+        ssize_t got = read(read_fd_, scratch, std::min(length, scratch_size));
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        pending_ -= got;
+        length -= got;
+        for (ssize_t done = 0; done < got;) {
+            ssize_t written = pwrite(file_fd, scratch + done, got - done,
+                                     static_cast<off_t>(offset));
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) return false;
+            done += written;
+            offset += written;
+        }
+    }
+    return true;
+}
+
+void SplicePipe::skip(size_t length, char* scratch, size_t scratch_size) {
+    length = std::min(length, pending_);
+    while (length > 0) {
+        ssize_t got = read(read_fd_, scratch, std::min(length, scratch_size));
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) {
+            // Unreadable leftovers would poison the next transfer.
+            close();
+            return;
+        }
+        pending_ -= got;
+        length -= got;
+    }
+}
+
+bool SplicePipe::unsupported(int error) {
+    return error == EINVAL || error == ENOSYS || error == EOPNOTSUPP || error == EXDEV;
+}
+
+}
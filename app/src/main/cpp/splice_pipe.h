@@ -0,0 +1,51 @@
+#ifndef ORION_SPLICE_PIPE_H
+#define ORION_SPLICE_PIPE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+
+namespace orion {
+
+// A pipe that moves socket data into a file with splice(2), so body bytes
+// go socket -> page cache without a user-space copy. Data spliced in with
+// fill() waits in the pipe until drainTo() places it at a file offset.
+class SplicePipe {
+public:
+    SplicePipe();
+    ~SplicePipe();
+    SplicePipe(SplicePipe&& other) noexcept;
+    SplicePipe& operator=(SplicePipe&& other) noexcept;
+    SplicePipe(const SplicePipe&) = delete;
+    SplicePipe& operator=(const SplicePipe&) = delete;
+
+    bool open();
+    void close();
+    bool isOpen() const { return read_fd_ >= 0; }
+    size_t capacity() const { return capacity_; }
+    size_t pending() const { return pending_; }
+
+    // Splices up to length bytes from the socket into the pipe.
+    ssize_t fill(int socket_fd, size_t length);
+    // Moves length pending bytes to the file at offset; on failure some may
+    // already have landed, and pending() says how many are left.
+    bool drainTo(int file_fd, int64_t offset, size_t length);
+    // User-space fallback for files whose filesystem refuses splice.
+    bool copyTo(int file_fd, int64_t offset, size_t length, char* scratch, size_t scratch_size);
+    // Reads pending bytes into scratch and drops them.
+    void skip(size_t length, char* scratch, size_t scratch_size);
+    void discard(char* scratch, size_t scratch_size) { skip(pending_, scratch, scratch_size); }
+
+    // The errors splice reports when the kernel or filesystem cannot do it.
+    static bool unsupported(int error);
+
+private:
+    int read_fd_;
+    int write_fd_;
+    size_t capacity_;
+    size_t pending_;
+};
+
+}
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef ORION_WORKER_POOL_H
+#define ORION_WORKER_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace orion {
+
+class WorkerPool {
+public:
+    explicit WorkerPool(int num_threads);
+    ~WorkerPool();
+
+    void submit(std::function<void()> task);
+    void shutdown();
+
+    int size() const { return static_cast<int>(threads_.size()); }
+
+private:
+    void workerLoop();
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> tasks_;
+    std::vector<std::thread> threads_;
+    bool stopping_;
+};
+
+}
+
+#endif
@@ -0,0 +1,219 @@
+#include "write_behind.h"
+#include "log.h"
+#include <unistd.h>
+#include <limits.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+
+#define LOG_TAG "OrionWriter"
+#define LOGE(...) orion::logPrint(orion::LogLevel::Error, LOG_TAG, __VA_ARGS__)
+
+namespace orion {
+
+constexpr size_t PAGE_ALIGNMENT = 4096;
+constexpr size_t MAX_IOV = IOV_MAX < 256 ? IOV_MAX : 256;
+
+BufferArena::BufferArena()
+    : memory_(nullptr)
+    , count_(0)
+    , interrupted_(false) {
+}
+
+BufferArena::~BufferArena() {
+    free(memory_);
+}
+
+bool BufferArena::reset(size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    interrupted_ = false;
+    if (count != count_) {
+        free(memory_);
+        memory_ = nullptr;
+        count_ = 0;
+        void* memory = nullptr;
+        if (posix_memalign(&memory, PAGE_ALIGNMENT, count * BUFFER_SIZE) != 0) {
+            return false;
+        }
+        memory_ = static_cast<char*>(memory);
+        count_ = count;
+        refs_.reset(new std::atomic<int>[count]);
+        free_.reserve(count);
+    }
+    free_.clear();
+    for (size_t i = count_; i > 0; --i) {
+        refs_[i - 1].store(0);
+        free_.push_back(static_cast<int>(i - 1));
+    }
+    return true;
+}
+
+int BufferArena::acquire() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    available_.wait(lock, [this] { return interrupted_ || !free_.empty(); });
+    if (interrupted_) return -1;
+    int buffer = free_.back();
+    free_.pop_back();
+    refs_[buffer].store(1);
+    return buffer;
+}
+
+void BufferArena::retain(int buffer) {
+    refs_[buffer].fetch_add(1, std::memory_order_relaxed);
+}
+
+void BufferArena::release(int buffer) {
+    if (refs_[buffer].fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(buffer);
+    }
+    available_.notify_one();
+}
+
+bool BufferArena::exclusive(int buffer) const {
+    return refs_[buffer].load(std::memory_order_acquire) == 1;
+}
+
+void BufferArena::interrupt() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        interrupted_ = true;
+    }
+    available_.notify_all();
+}
+
+WriteBehind::WriteBehind()
+    : fd_(-1)
+    , sync_bytes_(0)
+    , unsynced_bytes_(0)
+    , failed_(false)
+    , stopping_(false) {
+}
+
+WriteBehind::~WriteBehind() {
+    stop();
+}
+
+bool WriteBehind::start(int fd, size_t buffers, int64_t sync_bytes, WrittenCallback on_written) {
+    stop();
+    if (!arena_.reset(std::max<size_t>(buffers, 2))) {
+        LOGE("Failed to allocate %zu write buffers", buffers);
+        return false;
+    }
+    fd_ = fd;
+    sync_bytes_ = sync_bytes;
+    unsynced_bytes_ = 0;
+    on_written_ = std::move(on_written);
+    // A buffer can carry the tail of one response and the head of the next.
+    queue_.reserve(arena_.count() * 2);
+    batch_.reserve(arena_.count() * 2);
+    iov_.reserve(MAX_IOV);
+    failed_.store(false);
+    stopping_ = false;
+    writer_ = std::thread(&WriteBehind::run, this);
+    return true;
+}
+
+bool WriteBehind::submit(int buffer, const char* data, size_t length, int64_t offset) {
+    if (failed()) return false;
+    arena_.retain(buffer);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back({buffer, data, length, offset});
+    }
+    queued_.notify_one();
+    return true;
+}
+
+bool WriteBehind::stop() {
+    if (!writer_.joinable()) return true;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    queued_.notify_one();
+    writer_.join();
+    on_written_ = nullptr;
+    return !failed();
+}
+
+void WriteBehind::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        queued_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty()) break;
+        batch_.swap(queue_);
+        lock.unlock();
+        writeBatch();
+        lock.lock();
+    }
+}
+
+void WriteBehind::writeBatch() {
+    std::sort(batch_.begin(), batch_.end(),
+              [](const Span& a, const Span& b) { return a.offset < b.offset; });
+
+    size_t first = 0;
+    while (first < batch_.size()) {
+        size_t last = first + 1;
+        int64_t end = batch_[first].offset + static_cast<int64_t>(batch_[first].length);
+        while (last < batch_.size() && last - first < MAX_IOV && batch_[last].offset == end) {
+            end += static_cast<int64_t>(batch_[last].length);
+            last++;
+        }
+        if (!failed() && !writeRun(first, last)) {
+            LOGE("Write-behind failed at offset %lld: %s", (long long)batch_[first].offset,
+                 strerror(errno));
+            failed_.store(true);
+            // Receivers stop at their next submit; wake any waiting on buffers.
+            arena_.interrupt();
+        }
+        for (size_t i = first; i < last; ++i) {
+            if (!failed() && on_written_) {
+                on_written_(batch_[i].data, static_cast<int64_t>(batch_[i].length),
+                            batch_[i].offset);
+            }
+            arena_.release(batch_[i].buffer);
+        }
+        first = last;
+    }
+    batch_.clear();
+
+    if (sync_bytes_ > 0 && unsynced_bytes_ >= sync_bytes_) {
+        fdatasync(fd_);
+        unsynced_bytes_ = 0;
+    }
+}
+
+bool WriteBehind::writeRun(size_t first, size_t last) {
+    iov_.clear();
+    for (size_t i = first; i < last; ++i) {
+        iov_.push_back({const_cast<char*>(batch_[i].data), batch_[i].length});
+    }
+
+    int64_t offset = batch_[first].offset;
+    struct iovec* iov = iov_.data();
+    int count = static_cast<int>(iov_.size());
+    while (count > 0) {
+        ssize_t written = pwritev(fd_, iov, count, static_cast<off_t>(offset));
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        offset += written;
+        unsynced_bytes_ += written;
+        while (count > 0 && static_cast<size_t>(written) >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + written;
+            iov->iov_len -= written;
+        }
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,107 @@
+#ifndef ORION_WRITE_BEHIND_H
+#define ORION_WRITE_BEHIND_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/uio.h>
+
+namespace orion {
+
+// Fixed set of page-aligned receive buffers carved from one allocation.
+// Buffers are reference counted: a connection that fills one hands a
+// reference to the writer with each body span and moves on to another
+// buffer once its own is shared.
+class BufferArena {
+public:
+    static constexpr size_t BUFFER_SIZE = 65536;
+
+    BufferArena();
+    ~BufferArena();
+    BufferArena(const BufferArena&) = delete;
+    BufferArena& operator=(const BufferArena&) = delete;
+
+    // Keeps the existing allocation when the count is unchanged.
+    bool reset(size_t count);
+    // Blocks while every buffer is in flight, which is the back-pressure on
+    // the network side. Returns -1 once interrupt() has been called.
+    int acquire();
+    void retain(int buffer);
+    void release(int buffer);
+    bool exclusive(int buffer) const;
+    void interrupt();
+
+    char* data(int buffer) const { return memory_ + static_cast<size_t>(buffer) * BUFFER_SIZE; }
+    size_t count() const { return count_; }
+
+private:
+    char* memory_;
+    size_t count_;
+    std::unique_ptr<std::atomic<int>[]> refs_;
+    std::vector<int> free_;
+    bool interrupted_;
+    mutable std::mutex mutex_;
+    std::condition_variable available_;
+};
+
+// Moves file writes off the receiving threads. Spans queued with submit()
+// are sorted by offset on a dedicated thread, merged where adjacent and
+// written with pwritev; the callback then runs for each span, in file order
+// within a batch. Disk stalls reach the network only once the arena is
+// exhausted.
+class WriteBehind {
+public:
+    using WrittenCallback = std::function<void(const char* data, int64_t length, int64_t offset)>;
+
+    WriteBehind();
+    ~WriteBehind();
+
+    // sync_bytes > 0 issues an fdatasync after that many bytes are written.
+    bool start(int fd, size_t buffers, int64_t sync_bytes, WrittenCallback on_written);
+    // Takes a reference on buffer until the span is written.
+    bool submit(int buffer, const char* data, size_t length, int64_t offset);
+    // Writes everything queued and joins the writer. False if a write failed.
+    bool stop();
+    // Wakes receivers blocked on the arena so a cancel is not held up.
+    void interrupt() { arena_.interrupt(); }
+
+    bool running() const { return writer_.joinable(); }
+    bool failed() const { return failed_.load(std::memory_order_relaxed); }
+    BufferArena& arena() { return arena_; }
+
+private:
+    struct Span {
+        int buffer;
+        const char* data;
+        size_t length;
+        int64_t offset;
+    };
+
+    void run();
+    void writeBatch();
+    bool writeRun(size_t first, size_t last);
+
+    BufferArena arena_;
+    int fd_;
+    int64_t sync_bytes_;
+    int64_t unsynced_bytes_;
+    WrittenCallback on_written_;
+    std::vector<Span> queue_;
+    std::vector<Span> batch_;
+    std::vector<struct iovec> iov_;
+    std::atomic<bool> failed_;
+    bool stopping_;
+    std::mutex mutex_;
+    std::condition_variable queued_;
+    std::thread writer_;
+};
+
+}
+
+#endif
@@ -10,12 +10,118 @@ class NativeDownloadEngine {
         val downloadedBytes: Long,
         val totalBytes: Long,
         val speedBps: Double,
-        val activeConnections: Int
+        val activeConnections: Int,
+        val etaSeconds: Long = -1L,
+        val decodedBytes: Long = downloadedBytes
     ) {
         val percentage: Float
             get() = if (totalBytes > 0) (downloadedBytes.toFloat() / totalBytes.toFloat()) * 100f else 0f
     }
     
+    data class ResourceInfo(
+        val finalUrl: String,
+        val contentLength: Long,
+        val supportsRanges: Boolean,
+        val etag: String,
+        val lastModified: String,
+        val contentType: String
+    )
+    
+    data class IntegrityResult(
+        val checked: Boolean,
+        val verified: Boolean,
+        val digest: String,
+        val corruptPieces: Int
+    )
+    
+    enum class Outcome {
+        NONE,
+        COMPLETED,
+        FAILED,
+        CANCELLED,
+        UNCHANGED
+    }
+    
+    enum class FailureReason {
+        NONE,
+        NETWORK,
+        HTTP_STATUS,
+        REMOTE_CHANGED,
+        STORAGE,
+        INTEGRITY
+    }
+    
+    // httpStatus is the last unexpected status; retries counts every segment retry.
+    // reusedBytes came from the local copy rather than the network.
+    class DownloadResult(
+        outcomeValue: Int,
+        reasonValue: Int,
+        val httpStatus: Int,
+        val retries: Int,
+        val reusedBytes: Long
+    ) {
+        val outcome: Outcome = Outcome.values().getOrElse(outcomeValue) { Outcome.NONE }
+        val reason: FailureReason = FailureReason.values().getOrElse(reasonValue) { FailureReason.NONE }
+    }
+    
+    // Timings are in microseconds; firstByteUs is -1 until a response arrives.
+    data class ConnectionStats(
+        val connectionId: Int,
+        val resolveUs: Long,
+        val connectUs: Long,
+        val connects: Long,
+        val firstByteUs: Long,
+        val requests: Long,
+        val responseWaitUs: Long,
+        val bytes: Long,
+        val recvWaitUs: Long,
+        val stallUs: Long,
+        val throttleUs: Long,
+        val writeUs: Long
+    )
+    
+    // Histogram bucket 0 counts zeros, bucket i counts values in [2^(i-1), 2^i).
+    // Hedge counters are filled even when stats collection is off.
+    class DownloadStats(
+        val enabled: Boolean,
+        val resolveUs: Long,
+        val connections: Array<ConnectionStats>,
+        val recvSizeHistogram: LongArray,
+        val writeLatencyHistogram: LongArray,
+        val hedges: Long,
+        val hedgesWon: Long,
+        val hedgeWastedBytes: Long
+    )
+    
+    enum class HashAlgorithm(val nativeValue: Int) {
+        NONE(0),
+        CRC32(1),
+        SHA256(2)
+    }
+    
+    // Per-piece digests let corrupt ranges be refetched instead of the whole file.
+    data class IntegrityOptions(
+        val algorithm: HashAlgorithm = HashAlgorithm.NONE,
+        val expectedDigest: String? = null,
+        val pieceSize: Long = 0L,
+        val pieceDigests: List<String> = emptyList()
+    )
+    
+    // Re-downloads into an existing file. The manifest lets blocks the old
+    // copy already has be reused; the validators it was fetched with let an
+    // unchanged file be skipped outright.
+    data class DeltaOptions(
+        val manifestUrl: String? = null,
+        val localEtag: String? = null,
+        val localLastModified: String? = null
+    )
+    
+    enum class IoBackend(val nativeValue: Int) {
+        THREADED(0),
+        EVENT_LOOP(1),
+        SPLICE(2)
+    }
+    
     fun interface ProgressCallback {
         fun onProgress(
             downloadedBytes: Long,
@@ -26,20 +132,33 @@ class NativeDownloadEngine {
     }
     
     private var engineId: Long = 0L
+    private var progressHandle: Long = -1L
     
     init {
         try {
             System.loadLibrary("orion_downloader")
             engineId = nativeCreate()
+            progressHandle = nativeProgressHandle(engineId)
             Log.i("NativeDownloadEngine", "C++ Engine created (HTTP-only): $engineId")
         } catch (e: Exception) {
             Log.w("NativeDownloadEngine", "Failed to load native library, will use Kotlin engine", e)
             engineId = 0L
+            progressHandle = -1L
         }
     }
     
     fun isNativeAvailable(): Boolean = engineId != 0L
     
+    suspend fun probe(url: String): ResourceInfo? = withContext(Dispatchers.IO) {
+        if (engineId == 0L) return@withContext null
+        try {
+            nativeProbe(engineId, url)
+        } catch (e: Exception) {
+            Log.e("NativeDownloadEngine", "probe error", e)
+            null
+        }
+    }
+    
     suspend fun getContentLength(url: String): Long = withContext(Dispatchers.IO) {
         if (engineId == 0L) return@withContext -1L
         try {
@@ -64,7 +183,18 @@ class NativeDownloadEngine {
         url: String,
         outputPath: String,
         numConnections: Int = 8,
-        progressCallback: ProgressCallback? = null
+        progressCallback: ProgressCallback? = null,
+        ioBackend: IoBackend = IoBackend.THREADED,
+        pipelineRequests: Boolean = false,
+        rateLimitBps: Long = 0L,
+        integrity: IntegrityOptions = IntegrityOptions(),
+        decompress: Boolean = false,
+        collectStats: Boolean = false,
+        writeBehindBuffers: Int = 0,
+        writeSyncBytes: Long = 0L,
+        mirrors: List<String> = emptyList(),
+        endgameBytes: Long = DEFAULT_ENDGAME_BYTES,
+        delta: DeltaOptions = DeltaOptions()
     ): Boolean = withContext(Dispatchers.IO) {
         if (engineId == 0L) return@withContext false
         try {
@@ -73,6 +203,22 @@ class NativeDownloadEngine {
                 url,
                 outputPath,
                 numConnections,
+                ioBackend.nativeValue,
+                pipelineRequests,
+                rateLimitBps,
+                decompress,
+                collectStats,
+                writeBehindBuffers,
+                writeSyncBytes,
+                mirrors.toTypedArray(),
+                endgameBytes,
+                delta.manifestUrl,
+                delta.localEtag,
+                delta.localLastModified,
+                integrity.algorithm.nativeValue,
+                integrity.expectedDigest,
+                integrity.pieceSize,
+                integrity.pieceDigests.toTypedArray(),
                 progressCallback ?: ProgressCallback { _, _, _, _ -> }
             )
         } catch (e: Exception) {
@@ -81,6 +227,54 @@ class NativeDownloadEngine {
         }
     }
     
+    // Takes the same options as startDownload; they also apply if the remote
+    // file changed and the download starts over.
+    suspend fun resumeFromJournal(
+        outputPath: String,
+        numConnections: Int = 8,
+        progressCallback: ProgressCallback? = null,
+        ioBackend: IoBackend = IoBackend.THREADED,
+        pipelineRequests: Boolean = false,
+        rateLimitBps: Long = 0L,
+        integrity: IntegrityOptions = IntegrityOptions(),
+        decompress: Boolean = false,
+        collectStats: Boolean = false,
+        writeBehindBuffers: Int = 0,
+        writeSyncBytes: Long = 0L,
+        mirrors: List<String> = emptyList(),
+        endgameBytes: Long = DEFAULT_ENDGAME_BYTES,
+        delta: DeltaOptions = DeltaOptions()
+    ): Boolean = withContext(Dispatchers.IO) {
+        if (engineId == 0L) return@withContext false
+        try {
+            nativeResumeFromJournal(
+                engineId,
+                outputPath,
+                numConnections,
+                ioBackend.nativeValue,
+                pipelineRequests,
+                rateLimitBps,
+                decompress,
+                collectStats,
+                writeBehindBuffers,
+                writeSyncBytes,
+                mirrors.toTypedArray(),
+                endgameBytes,
+                delta.manifestUrl,
+                delta.localEtag,
+                delta.localLastModified,
+                integrity.algorithm.nativeValue,
+                integrity.expectedDigest,
+                integrity.pieceSize,
+                integrity.pieceDigests.toTypedArray(),
+                progressCallback ?: ProgressCallback { _, _, _, _ -> }
+            )
+        } catch (e: Exception) {
+            Log.e("NativeDownloadEngine", "resumeFromJournal error", e)
+            false
+        }
+    }
+    
     fun pauseDownload() {
         if (engineId == 0L) return
         try {
@@ -108,8 +302,18 @@ class NativeDownloadEngine {
         }
     }
     
+    fun setRateLimit(bytesPerSecond: Long) {
+        if (engineId == 0L) return
+        try {
+            nativeSetRateLimit(engineId, bytesPerSecond)
+        } catch (e: Exception) {
+            Log.e("NativeDownloadEngine", "setRateLimit error", e)
+        }
+    }
+    
     fun isDownloading(): Boolean {
         if (engineId == 0L) return false
+        if (progressHandle >= 0) return NativeProgressBoard.isDownloading(progressHandle)
         return try {
             nativeIsDownloading(engineId)
         } catch (e: Exception) {
@@ -130,6 +334,7 @@ class NativeDownloadEngine {
     
     fun getProgress(): DownloadProgress? {
         if (engineId == 0L) return null
+        NativeProgressBoard.read(progressHandle)?.let { return it }
         return try {
             nativeGetProgress(engineId)
         } catch (e: Exception) {
@@ -138,6 +343,36 @@ class NativeDownloadEngine {
         }
     }
     
+    fun getIntegrity(): IntegrityResult? {
+        if (engineId == 0L) return null
+        return try {
+            nativeGetIntegrity(engineId)
+        } catch (e: Exception) {
+            Log.e("NativeDownloadEngine", "getIntegrity error", e)
+            null
+        }
+    }
+    
+    fun getResult(): DownloadResult? {
+        if (engineId == 0L) return null
+        return try {
+            nativeGetResult(engineId)
+        } catch (e: Exception) {
+            Log.e("NativeDownloadEngine", "getResult error", e)
+            null
+        }
+    }
+    
+    fun getStats(): DownloadStats? {
+        if (engineId == 0L) return null
+        return try {
+            nativeGetStats(engineId)
+        } catch (e: Exception) {
+            Log.e("NativeDownloadEngine", "getStats error", e)
+            null
+        }
+    }
+    
     fun destroy() {
         if (engineId != 0L) {
             try {
@@ -146,6 +381,7 @@ class NativeDownloadEngine {
                 Log.e("NativeDownloadEngine", "destroy error", e)
             }
             engineId = 0L
+            progressHandle = -1L
         }
     }
     
@@ -153,21 +389,86 @@ class NativeDownloadEngine {
         destroy()
     }
     
+    companion object {
+        // Pass as numConnections to let measured throughput pick the count.
+        const val AUTO_CONNECTIONS = 0
+
+        // Tail size below which idle connections race duplicate requests; 0 disables.
+        const val DEFAULT_ENDGAME_BYTES = 2L * 1024 * 1024
+
+        // Shared by every native download in the process; 0 removes the cap.
+        fun setGlobalRateLimit(bytesPerSecond: Long) {
+            try {
+                System.loadLibrary("orion_downloader")
+                nativeSetGlobalRateLimit(bytesPerSecond)
+            } catch (e: Throwable) {
+                Log.e("NativeDownloadEngine", "setGlobalRateLimit error", e)
+            }
+        }
+        
+        @JvmStatic
+        private external fun nativeSetGlobalRateLimit(bytesPerSecond: Long)
+    }
+    
     private external fun nativeCreate(): Long
     private external fun nativeDestroy(engineId: Long)
     private external fun nativeGetContentLength(engineId: Long, url: String): Long
     private external fun nativeSupportsRangeRequests(engineId: Long, url: String): Boolean
+    private external fun nativeProbe(engineId: Long, url: String): ResourceInfo?
     private external fun nativeStartDownload(
         engineId: Long,
         url: String,
         outputPath: String,
         numConnections: Int,
+        ioBackend: Int,
+        pipelineRequests: Boolean,
+        rateLimit: Long,
+        decompress: Boolean,
+        collectStats: Boolean,
+        writeBehindBuffers: Int,
+        writeSyncBytes: Long,
+        mirrors: Array<String>,
+        endgameBytes: Long,
+        deltaManifestUrl: String?,
+        localEtag: String?,
+        localLastModified: String?,
+        hashAlgorithm: Int,
+        expectedDigest: String?,
+        pieceSize: Long,
+        pieceDigests: Array<String>,
+        callback: ProgressCallback
+    ): Boolean
+    private external fun nativeResumeFromJournal(
+        engineId: Long,
+        outputPath: String,
+        numConnections: Int,
+        ioBackend: Int,
+        pipelineRequests: Boolean,
+        rateLimit: Long,
+        decompress: Boolean,
+        collectStats: Boolean,
+        writeBehindBuffers: Int,
+        writeSyncBytes: Long,
+        mirrors: Array<String>,
+        endgameBytes: Long,
+        deltaManifestUrl: String?,
+        localEtag: String?,
+        localLastModified: String?,
+        hashAlgorithm: Int,
+        expectedDigest: String?,
+        pieceSize: Long,
+        pieceDigests: Array<String>,
         callback: ProgressCallback
     ): Boolean
     private external fun nativePauseDownload(engineId: Long)
     private external fun nativeResumeDownload(engineId: Long)
     private external fun nativeCancelDownload(engineId: Long)
+    private external fun nativeSetRateLimit(engineId: Long, bytesPerSecond: Long)
+    private external fun nativeProgressHandle(engineId: Long): Long
     private external fun nativeIsDownloading(engineId: Long): Boolean
     private external fun nativeIsPaused(engineId: Long): Boolean
     private external fun nativeGetProgress(engineId: Long): DownloadProgress?
+    private external fun nativeGetIntegrity(engineId: Long): IntegrityResult?
+    private external fun nativeGetResult(engineId: Long): DownloadResult?
+    private external fun nativeGetStats(engineId: Long): DownloadStats?
 }
@@ -0,0 +1,146 @@
+package com.orion.downloader.core
+
+import android.util.Log
+
+class NativeDownloadManager(
+    maxConnections: Int = 16,
+    maxConnectionsPerHost: Int = 6
+) {
+
+    enum class JobState {
+        QUEUED,
+        PREPARING,
+        ACTIVE,
+        COMPLETED,
+        FAILED,
+        CANCELLED,
+        UNKNOWN;
+
+        companion object {
+            fun fromNative(value: Int): JobState = values().getOrElse(value) { UNKNOWN }
+        }
+    }
+
+    interface JobListener {
+        fun onProgress(
+            downloadedBytes: Long,
+            totalBytes: Long,
+            speedBps: Double,
+            activeConnections: Int
+        )
+
+        fun onFinished(jobId: Long, state: Int)
+    }
+
+    private var managerId: Long = 0L
+
+    init {
+        try {
+            System.loadLibrary("orion_downloader")
+            managerId = nativeCreate(maxConnections, maxConnectionsPerHost)
+            Log.i("NativeDownloadManager", "C++ manager created: $managerId")
+        } catch (e: Throwable) {
+            Log.w("NativeDownloadManager", "Failed to load native library", e)
+            managerId = 0L
+        }
+    }
+
+    fun isNativeAvailable(): Boolean = managerId != 0L
+
+    fun submit(
+        url: String,
+        outputPath: String,
+        priority: Int = 0,
+        numConnections: Int = 8,
+        listener: JobListener
+    ): Long {
+        if (managerId == 0L) return -1L
+        return try {
+            nativeSubmit(managerId, url, outputPath, priority, numConnections, listener)
+        } catch (e: Exception) {
+            Log.e("NativeDownloadManager", "submit error", e)
+            -1L
+        }
+    }
+
+    fun cancel(jobId: Long): Boolean {
+        if (managerId == 0L) return false
+        return nativeCancel(managerId, jobId)
+    }
+
+    fun pause(jobId: Long): Boolean {
+        if (managerId == 0L) return false
+        return nativePause(managerId, jobId)
+    }
+
+    fun resume(jobId: Long): Boolean {
+        if (managerId == 0L) return false
+        return nativeResume(managerId, jobId)
+    }
+
+    fun setPriority(jobId: Long, priority: Int): Boolean {
+        if (managerId == 0L) return false
+        return nativeSetPriority(managerId, jobId, priority)
+    }
+
+    fun setRateLimit(jobId: Long, bytesPerSecond: Long): Boolean {
+        if (managerId == 0L) return false
+        return nativeSetRateLimit(managerId, jobId, bytesPerSecond)
+    }
+
+    fun release(jobId: Long) {
+        if (managerId == 0L) return
+        nativeRelease(managerId, jobId)
+    }
+
+    fun getState(jobId: Long): JobState {
+        if (managerId == 0L) return JobState.UNKNOWN
+        return JobState.fromNative(nativeGetState(managerId, jobId))
+    }
+
+    fun progressHandle(jobId: Long): Long {
+        if (managerId == 0L) return -1L
+        return nativeProgressHandle(managerId, jobId)
+    }
+
+    fun getProgress(jobId: Long): NativeDownloadEngine.DownloadProgress? {
+        if (managerId == 0L) return null
+        return try {
+            nativeGetProgress(managerId, jobId)
+        } catch (e: Exception) {
+            Log.e("NativeDownloadManager", "getProgress error", e)
+            null
+        }
+    }
+
+    fun destroy() {
+        if (managerId != 0L) {
+            try {
+                nativeDestroy(managerId)
+            } catch (e: Exception) {
+                Log.e("NativeDownloadManager", "destroy error", e)
+            }
+            managerId = 0L
+        }
+    }
+
+    private external fun nativeCreate(maxConnections: Int, maxConnectionsPerHost: Int): Long
+    private external fun nativeDestroy(managerId: Long)
+    private external fun nativeSubmit(
+        managerId: Long,
+        url: String,
+        outputPath: String,
+        priority: Int,
+        numConnections: Int,
+        listener: JobListener
+    ): Long
+    private external fun nativeCancel(managerId: Long, jobId: Long): Boolean
+    private external fun nativePause(managerId: Long, jobId: Long): Boolean
+    private external fun nativeResume(managerId: Long, jobId: Long): Boolean
+    private external fun nativeSetPriority(managerId: Long, jobId: Long, priority: Int): Boolean
+    private external fun nativeSetRateLimit(managerId: Long, jobId: Long, bytesPerSecond: Long): Boolean
+    private external fun nativeRelease(managerId: Long, jobId: Long)
+    private external fun nativeGetState(managerId: Long, jobId: Long): Int
+    private external fun nativeProgressHandle(managerId: Long, jobId: Long): Long
+    private external fun nativeGetProgress(managerId: Long, jobId: Long): NativeDownloadEngine.DownloadProgress?
+}
@@ -0,0 +1,70 @@
+package com.orion.downloader.core
+
+import android.util.Log
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+// Polls native progress without JNI calls. Slot layout mirrors
+// ProgressBoard::Slot in progress_board.h: every field is an aligned 64-bit
+// value, so a read can mix two neighbouring updates but never tears one
+// field, and the generation read on both sides of the fields shows whether
+// the slot still belongs to the handle's download.
+object NativeProgressBoard {
+
+    private const val SLOT_SIZE = 64
+    private const val GENERATION = 0
+    private const val DOWNLOADED = 8
+    private const val TOTAL = 16
+    private const val SPEED = 24
+    private const val ETA = 32
+    private const val ACTIVE = 40
+    private const val DOWNLOADING = 48
+    private const val DECODED = 56
+
+    private val board: ByteBuffer? by lazy {
+        try {
+            System.loadLibrary("orion_downloader")
+            nativeBoard()?.order(ByteOrder.nativeOrder())
+        } catch (e: Throwable) {
+            Log.w("NativeProgressBoard", "Progress board unavailable", e)
+            null
+        }
+    }
+
+    // Null when the handle is invalid or its slot now belongs to another download.
+    fun read(handle: Long): NativeDownloadEngine.DownloadProgress? {
+        val buffer = board ?: return null
+        val base = slotBase(buffer, handle) ?: return null
+        if (!owns(buffer, base, handle)) return null
+
+        val progress = NativeDownloadEngine.DownloadProgress(
+            downloadedBytes = buffer.getLong(base + DOWNLOADED),
+            totalBytes = buffer.getLong(base + TOTAL),
+            speedBps = buffer.getDouble(base + SPEED),
+            activeConnections = buffer.getLong(base + ACTIVE).toInt(),
+            etaSeconds = buffer.getLong(base + ETA),
+            decodedBytes = buffer.getLong(base + DECODED)
+        )
+        return if (owns(buffer, base, handle)) progress else null
+    }
+
+    fun isDownloading(handle: Long): Boolean {
+        val buffer = board ?: return false
+        val base = slotBase(buffer, handle) ?: return false
+        if (!owns(buffer, base, handle)) return false
+        val downloading = buffer.getLong(base + DOWNLOADING) != 0L
+        return downloading && owns(buffer, base, handle)
+    }
+
+    private fun slotBase(buffer: ByteBuffer, handle: Long): Int? {
+        if (handle < 0) return null
+        val base = (handle and 0xffffffffL).toInt() * SLOT_SIZE
+        return if (base + SLOT_SIZE <= buffer.capacity()) base else null
+    }
+
+    private fun owns(buffer: ByteBuffer, base: Int, handle: Long): Boolean =
+        (buffer.getLong(base + GENERATION) and 0x7fffffffL) == handle ushr 32
+
+    @JvmStatic
+    private external fun nativeBoard(): ByteBuffer?
+}